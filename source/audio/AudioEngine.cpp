@@ -1,21 +1,29 @@
 #include "AudioEngine.h"
-#include <iostream>
+#include "Realtime.h"
+#include "AllocTracker.h"
+#include "Log.h"
 #include <cmath>
 #include <algorithm>
 #include <thread>
 #include <cstring>
-#include <random>
 #include <chrono>
+#include <cstdlib>
 
-AudioEngine::AudioEngine() {
-    // Initialize FFmpeg logging and OpenAL device/context
-    av_log_set_level(AV_LOG_ERROR);
+AudioEngine::AudioEngine() = default;
+
+// Opening the device can take a while (sound servers), so it is not done
+// during static initialization but on a startup thread
+void AudioEngine::init() {
+    if (m_device) return;
+
+    // OpenAL device/context
     m_device = alcOpenDevice(nullptr);
     if (!m_device) throw std::runtime_error("OpenAL: Failed to open device");
 
     m_context = alcCreateContext(m_device, nullptr);
     if (!m_context || !alcMakeContextCurrent(m_context)) {
         alcCloseDevice(m_device);
+        m_device = nullptr;
         throw std::runtime_error("OpenAL: Failed to create context");
     }
 
@@ -24,6 +32,20 @@ AudioEngine::AudioEngine() {
     alGenBuffers(NUM_BUFFERS, m_buffers);
 
     m_decodeBuffer.resize(BUFFER_SAMPLES * 2); // stereo buffer
+    m_sourceBlock.resize(BUFFER_SAMPLES * 2);
+
+    if (m_realtime) {
+        m_ring = std::make_unique<PcmRing>(RING_FRAMES);
+        m_feedBuffer.resize(BUFFER_SAMPLES * 2);
+        // A page fault on the feeder would cost as much as being preempted
+        if (!LockMemory(m_ring->data(), m_ring->bytes()) ||
+            !LockMemory(m_feedBuffer.data(), m_feedBuffer.size() * sizeof(int16_t)))
+            LOG_WARNING("Audio: could not lock playback buffers in memory");
+
+        m_thread = std::thread(&AudioEngine::realtimeFeederThread, this);
+        m_decoderThread = std::thread(&AudioEngine::decoderThread, this);
+        return;
+    }
 
     // Start worker thread for streaming audio
     m_thread = std::thread(&AudioEngine::workerThread, this);
@@ -34,10 +56,13 @@ AudioEngine::~AudioEngine() {
     m_running = false;
     m_switchCv.notify_one();
     if (m_thread.joinable()) m_thread.join();
+    if (m_decoderThread.joinable()) m_decoderThread.join();
 
     // Cleanup
-    alDeleteSources(1, &m_source);
-    alDeleteBuffers(NUM_BUFFERS, m_buffers);
+    if (m_device) {
+        alDeleteSources(1, &m_source);
+        alDeleteBuffers(NUM_BUFFERS, m_buffers);
+    }
 
     if (m_swr) swr_free(&m_swr);
     if (m_codec) avcodec_free_context(&m_codec);
@@ -53,16 +78,30 @@ ALenum AudioEngine::formatFromChannels(int channels) {
     return channels == 1 ? AL_FORMAT_MONO16 : AL_FORMAT_STEREO16;
 }
 
+bool AudioEngine::FastOpenDefault() {
+    const char* fast = std::getenv("VESPER_FAST_OPEN");
+    return !fast || std::strcmp(fast, "0") != 0;
+}
+
+// Whatever the fast path cannot play is opened again with full probing
 bool AudioEngine::openFile(const std::string& path) {
+    if (m_fastOpen.load() && openStream(path, true)) return true;
+    return openStream(path, false);
+}
+
+bool AudioEngine::openStream(const std::string& path, bool fast) {
     // Close previous file if open
     if (m_fmt) {
         avformat_close_input(&m_fmt);
         m_fmt = nullptr;
     }
+    if (m_codec) avcodec_free_context(&m_codec);
 
     // Open audio file
-    if (avformat_open_input(&m_fmt, path.c_str(), nullptr, nullptr) < 0) return false;
-    if (avformat_find_stream_info(m_fmt, nullptr) < 0) return false;
+    MediaOpenResult opened = OpenMediaInput(path, fast);
+    m_fmt = opened.fmt;
+    if (!m_fmt) return false;
+    m_openedFast = opened.skippedProbe;
 
     // Find best audio stream
     m_streamIdx = av_find_best_stream(m_fmt, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
@@ -76,7 +115,8 @@ bool AudioEngine::openFile(const std::string& path) {
     m_codec = avcodec_alloc_context3(codec);
     avcodec_parameters_to_context(m_codec, audio_stream->codecpar);
     if (avcodec_open2(m_codec, codec, nullptr) < 0) return false;
-    
+    if (m_codec->sample_fmt == AV_SAMPLE_FMT_NONE || m_codec->sample_rate <= 0) return false;
+
     m_channels = m_codec->ch_layout.nb_channels;
 
     // Setup resampler for stereo output
@@ -98,18 +138,29 @@ bool AudioEngine::openFile(const std::string& path) {
     );
 
     if (ret < 0 || swr_init(m_swr) < 0) {
-        std::cerr << "Failed to initialize SwrContext\n";
+        LOG_ERROR("Failed to initialize SwrContext");
         return false;
     }
 
-    // Store audio duration in seconds
-    m_duration.store((double)audio_stream->duration * av_q2d(audio_stream->time_base));
+    m_sampleRate.store(m_codec->sample_rate);
+    m_seekTargetSample = -1;
+    m_stretch.configure(m_codec->sample_rate);
+    m_clock.reset(0.0);
+    m_sourceOrigin = 0.0;
+    m_outputFrames = 0.0;
+    m_sourceAtEnd = false;
+
+    // Store audio duration in seconds; some headers only give the container's
+    if (audio_stream->duration != AV_NOPTS_VALUE)
+        m_duration.store((double)audio_stream->duration * av_q2d(audio_stream->time_base));
+    else
+        m_duration.store(m_fmt->duration != AV_NOPTS_VALUE ? (double)m_fmt->duration / AV_TIME_BASE : 0.0);
     return true;
 }
 
 
 
-int AudioEngine::decodeNextBlock(int16_t* outBuffer, int maxSamples) {
+int AudioEngine::decodeSourceBlock(int16_t* outBuffer, int maxSamples) {
     // Decode next block of samples, resample to stereo
     if (!m_fmt || !m_codec) return 0;
 
@@ -128,6 +179,8 @@ int AudioEngine::decodeNextBlock(int16_t* outBuffer, int maxSamples) {
                     uint8_t* outBuf[2] = { (uint8_t*)(outBuffer + totalSamples * 2), nullptr };
                     int converted = swr_convert(m_swr, outBuf, outSamples,
                                                 (const uint8_t**)frame->data, frame->nb_samples);
+                    if (m_seekTargetSample >= 0 && converted > 0)
+                        converted = dropBeforeSeekTarget(frame, outBuffer + totalSamples * 2, converted);
 
                     totalSamples += converted;
                     if (totalSamples >= maxSamples) break;
@@ -141,13 +194,98 @@ int AudioEngine::decodeNextBlock(int16_t* outBuffer, int maxSamples) {
     return totalSamples;
 }
 
-void AudioEngine::loadAndPlay(const std::string& filePath) {
-    auto it = std::find(audioFiles.begin(), audioFiles.end(), filePath);
-    if (it != audioFiles.end()) {
-        m_currentIndex.store(static_cast<int>(it - audioFiles.begin()));
-    } else {
-        m_currentIndex.store(-1);  // файл не из плейлиста
+// Decoded audio after the time-stretch stage; m_trackMutex is held
+int AudioEngine::decodeNextBlock(int16_t* outBuffer, int maxSamples) {
+    if (!m_fmt || !m_codec) return 0;
+
+    m_stretch.setSpeed(m_speed.load());
+    while (m_stretch.available() < static_cast<size_t>(maxSamples) && !m_sourceAtEnd) {
+        int decoded = decodeSourceBlock(m_sourceBlock.data(), BUFFER_SAMPLES);
+        if (decoded > 0) {
+            m_stretch.push(m_sourceBlock.data(), static_cast<size_t>(decoded));
+        }
+        else {
+            m_stretch.flush();
+            m_sourceAtEnd = true;
+        }
+    }
+
+    int produced = static_cast<int>(m_stretch.pop(outBuffer, static_cast<size_t>(maxSamples)));
+    m_outputFrames += produced;
+    m_clock.mark(m_outputFrames, m_sourceOrigin + m_stretch.sourcePosition());
+    return produced;
+}
+
+// Track time of what the device plays `offsetSec` into its queue; m_trackMutex is held
+double AudioEngine::sourceSeconds(double offsetSec) {
+    const int rate = m_sampleRate.load();
+    if (rate <= 0) return 0.0;
+    return m_clock.sourceAt(m_playedSamples + offsetSec * rate) / rate;
+}
+
+// After a seek the demuxer lands on the packet at or before the target;
+// drop the samples in front of it. Returns how many of `count` are left.
+int AudioEngine::dropBeforeSeekTarget(const AVFrame* frame, int16_t* samples, int count) {
+    if (frame->pts == AV_NOPTS_VALUE) {
+        m_seekTargetSample = -1; // no timestamps to go by
+        return count;
     }
+    const AVStream* stream = m_fmt->streams[m_streamIdx];
+    int64_t start = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    int64_t first = std::llround((frame->pts - start) * av_q2d(stream->time_base) * m_codec->sample_rate);
+    int64_t drop = std::clamp<int64_t>(m_seekTargetSample - first, 0, count);
+    if (first + count >= m_seekTargetSample) m_seekTargetSample = -1;
+
+    if (drop > 0) std::memmove(samples, samples + drop * 2, (count - drop) * 2 * sizeof(int16_t));
+    return count - static_cast<int>(drop);
+}
+
+// Moves the demuxer to `seconds`, sample exact; m_trackMutex is held
+bool AudioEngine::seekStream(double seconds) {
+    int64_t ts = static_cast<int64_t>(seconds / av_q2d(m_fmt->streams[m_streamIdx]->time_base));
+    if (av_seek_frame(m_fmt, m_streamIdx, ts, AVSEEK_FLAG_BACKWARD) < 0) return false;
+    avcodec_flush_buffers(m_codec);
+
+    m_seekTargetSample = std::llround(seconds * m_codec->sample_rate);
+    m_playedSamples = 0.0;
+    m_stretch.reset();
+    m_sourceOrigin = seconds * m_codec->sample_rate;
+    m_outputFrames = 0.0;
+    m_clock.reset(m_sourceOrigin);
+    m_sourceAtEnd = false;
+    return true;
+}
+
+bool AudioEngine::loadAndPlay(const std::string& filePath) {
+    return openTrack(filePath, 0.0, true);
+}
+
+void AudioEngine::cue(const std::string& filePath, double seconds) {
+    openTrack(filePath, seconds, false);
+}
+
+bool AudioEngine::openTrack(const std::string& filePath, double startSeconds, bool startPlaying) {
+    AllocScope alloc(AllocTag::Audio);
+    auto requested = std::chrono::steady_clock::now();
+    TrackId id = GetLibrary()->find(filePath);
+    updatePlayback([&](PlaybackState& state) {
+        state.currentTrack = id;
+        if (id == INVALID_TRACK) return;
+
+        uint64_t index = id;
+        if (state.playlist) {
+            // Keep the playlist position unless the caller already pointed it at this entry
+            const auto& tracks = state.playlist->tracks;
+            if (state.playlistPos >= tracks.size() || tracks[state.playlistPos] != id) {
+                auto it = std::find(tracks.begin(), tracks.end(), id);
+                if (it == tracks.end()) return;
+                state.playlistPos = static_cast<size_t>(it - tracks.begin());
+            }
+            index = state.playlistPos;
+        }
+        // A track picked by hand: next and previous go on from its place in the order
+        if (state.shuffle && index < state.shuffle->steps()) state.shuffleStep = state.shuffle->stepOf(index);
+    });
 
     // Stop current track and request switch
     {
@@ -156,14 +294,19 @@ void AudioEngine::loadAndPlay(const std::string& filePath) {
         m_trackSwitchRequested = true;
 
         stop();
-        
+        resetFeed();
 
-        if (!openFile(filePath)) {
-            std::cerr << "Failed to open audio file: " << filePath << "\n";
+        bool opened = openFile(filePath);
+        auto openedAt = std::chrono::steady_clock::now();
+        if (!opened) {
+            LOG_ERROR("Failed to open audio file: " << filePath);
             m_trackSwitchRequested = false;
             m_switchCv.notify_one();  // wake worker
-            return;
+            notifyStateChanged();
+            return false;
         }
+        if (startSeconds > 0.0 && startSeconds < m_duration.load() && !seekStream(startSeconds))
+            LOG_ERROR("Failed to seek audio");
 
         // Fill initial OpenAL buffers
         for (int i = 0; i < NUM_BUFFERS; ++i) {
@@ -176,14 +319,22 @@ void AudioEngine::loadAndPlay(const std::string& filePath) {
 
         alSourceQueueBuffers(m_source, NUM_BUFFERS, m_buffers);
         alSourcef(m_source, AL_GAIN, m_volume.load());
-        alSourcePlay(m_source);
+        if (startPlaying) {
+            alSourcePlay(m_source);
+            using Ms = std::chrono::duration<double, std::milli>;
+            recordTrackStart(Ms(openedAt - requested).count(), Ms(std::chrono::steady_clock::now() - requested).count());
+        }
 
-        m_playing = true;
-        m_currentFile = filePath;
+        m_playing = startPlaying;
+        m_position.store(sourceSeconds(0.0));
+        updatePlayback([&](PlaybackState& state) { state.currentFile = filePath; });
 
         m_trackSwitchRequested = false;
     }
     m_switchCv.notify_one(); // wake worker
+    notifyStateChanged();
+    prefetchUpcoming();
+    return true;
 }
 
 // Resume playback
@@ -196,6 +347,7 @@ void AudioEngine::play() {
         }
     }
     m_switchCv.notify_one();
+    notifyStateChanged();
 }
 
 // Pause playback
@@ -208,6 +360,7 @@ void AudioEngine::pause() {
         }
     }
     m_switchCv.notify_one();
+    notifyStateChanged();
 }
 
 // Toogle play/pause state
@@ -229,10 +382,46 @@ void AudioEngine::stop() {
     m_playing = false;
     m_position.store(0.0);
     m_playedSamples = 0;
+    notifyStateChanged();
+}
+
+void AudioEngine::setStateListener(std::function<void()> listener) {
+    std::lock_guard<std::mutex> lock(m_listenerMutex);
+    m_stateListener = std::move(listener);
+}
+
+void AudioEngine::updatePlayback(const std::function<void(PlaybackState&)>& change) {
+    {
+        std::lock_guard<std::mutex> lock(m_playbackWriteMutex);
+        auto next = std::make_shared<PlaybackState>(*std::atomic_load(&m_playback));
+        change(*next);
+        next->version++;
+        std::atomic_store(&m_playback, std::shared_ptr<const PlaybackState>(std::move(next)));
+    }
+    notifyStateChanged();
+}
+
+void AudioEngine::updateLibrary(const std::function<void(Library&)>& change) {
+    AllocScope alloc(AllocTag::Library);
+    std::lock_guard<std::mutex> lock(m_libraryWriteMutex);
+    auto next = std::make_shared<Library>(*std::atomic_load(&m_library));
+    change(*next);
+    std::atomic_store(&m_library, std::shared_ptr<const Library>(std::move(next)));
+}
+
+void AudioEngine::notifyStateChanged() {
+    m_stateVersion.fetch_add(1);
+    std::function<void()> listener;
+    {
+        std::lock_guard<std::mutex> lock(m_listenerMutex);
+        listener = m_stateListener;
+    }
+    if (listener) listener();
 }
 
 // Worker thread: stream audio
 void AudioEngine::workerThread() {
+    AllocScope alloc(AllocTag::Audio);
     while (m_running) {
         {
             std::unique_lock<std::mutex> lock(m_trackMutex);
@@ -281,30 +470,200 @@ void AudioEngine::workerThread() {
             ALint state;
             alGetSourcei(m_source, AL_SOURCE_STATE, &state);
             if (state != AL_PLAYING && state != AL_PAUSED) {
+                if (state == AL_STOPPED) m_underruns.fetch_add(1, std::memory_order_relaxed); // ran dry before the refill
                 alSourcePlay(m_source);
             }
 
             // Update playback position
             float offsetSec = 0.0f;
             alGetSourcef(m_source, AL_SEC_OFFSET, &offsetSec);
-            double positionSec = m_playedSamples / static_cast<double>(m_codec->sample_rate);
-            m_position.store(positionSec + offsetSec);
+            m_position.store(sourceSeconds(offsetSec));
         }
 
         std::this_thread::sleep_for(std::chrono::milliseconds(5));
     }
 }
 
+// Real-time mode: the feeder only moves decoded frames from the ring into the
+// device queue. It never allocates, and never waits for the track mutex;
+// while the GUI switches tracks or seeks it simply tries again shortly.
+void AudioEngine::realtimeFeederThread() {
+    AllocScope alloc(AllocTag::Audio);
+    std::string error;
+    if (!PromoteThreadToRealtime(error))
+        LOG_WARNING("Audio: real-time priority not available (" << error << "), feeding at normal priority");
+
+    while (m_running) {
+        if (m_playing && !m_trackSwitchRequested) {
+            std::unique_lock<std::mutex> lock(m_trackMutex, std::try_to_lock);
+            if (!lock.owns_lock()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            feedDevice();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(m_playing ? 5 : 10));
+    }
+}
+
+// One refill pass of the device queue; m_trackMutex is held
+void AudioEngine::feedDevice() {
+    const int rate = m_sampleRate.load();
+    if (rate <= 0) return;
+    const double bufferSeconds = BUFFER_SAMPLES / static_cast<double>(rate);
+
+    ALint processed = 0, queued = 0, state = 0;
+    alGetSourcei(m_source, AL_BUFFERS_PROCESSED, &processed);
+    alGetSourcei(m_source, AL_BUFFERS_QUEUED, &queued);
+    alGetSourcei(m_source, AL_SOURCE_STATE, &state);
+
+    if (processed > 0 && !m_decoderAtEnd) { // running dry at the end of a track is expected
+        // Deadline: the device plays the last queued sample
+        float offset = 0.0f;
+        alGetSourcef(m_source, AL_SEC_OFFSET, &offset);
+        bool underrun = state != AL_PLAYING;
+        double margin = underrun ? 0.0 : std::max(0.0, queued * bufferSeconds - offset);
+        recordRefill(margin, bufferSeconds, underrun);
+    }
+
+    while (processed-- > 0) {
+        ALuint buf;
+        alSourceUnqueueBuffers(m_source, 1, &buf);
+
+        ALint size = 0;
+        alGetBufferi(buf, AL_SIZE, &size);
+        m_playedSamples += size / 4; // 2 channels * 2 bytes
+        m_spareBuffers[m_spareCount++] = buf;
+    }
+
+    // Full buffers only, so OpenAL keeps reusing the same storage; the tail of a track is the exception
+    while (m_spareCount > 0 && (m_ring->available() >= BUFFER_SAMPLES || (m_decoderAtEnd && m_ring->available() > 0))) {
+        size_t frames = m_ring->pop(m_feedBuffer.data(), BUFFER_SAMPLES);
+        ALuint buf = m_spareBuffers[--m_spareCount];
+        alBufferData(buf, AL_FORMAT_STEREO16, m_feedBuffer.data(), static_cast<ALsizei>(frames * 4), rate);
+        alSourceQueueBuffers(m_source, 1, &buf);
+    }
+
+    // Restart after an underrun
+    alGetSourcei(m_source, AL_SOURCE_STATE, &state);
+    alGetSourcei(m_source, AL_BUFFERS_QUEUED, &queued);
+    if (state != AL_PLAYING && state != AL_PAUSED && queued > 0) alSourcePlay(m_source);
+
+    float offsetSec = 0.0f;
+    alGetSourcef(m_source, AL_SEC_OFFSET, &offsetSec);
+    m_position.store(sourceSeconds(offsetSec));
+}
+
+void AudioEngine::recordRefill(double margin, double bufferSeconds, bool underrun) {
+    m_refills.fetch_add(1, std::memory_order_relaxed);
+    if (underrun) m_underruns.fetch_add(1, std::memory_order_relaxed);
+    else if (margin < bufferSeconds) m_nearMisses.fetch_add(1, std::memory_order_relaxed);
+
+    double worst = m_worstMargin.load(std::memory_order_relaxed);
+    while ((worst < 0.0 || margin < worst) &&
+           !m_worstMargin.compare_exchange_weak(worst, margin, std::memory_order_relaxed)) {}
+}
+
+AudioEngine::DeadlineStats AudioEngine::deadlineStats() const {
+    DeadlineStats stats;
+    stats.refills = m_refills.load();
+    stats.nearMisses = m_nearMisses.load();
+    stats.underruns = m_underruns.load();
+    stats.worstMarginMs = std::max(0.0, m_worstMargin.load()) * 1000.0;
+    return stats;
+}
+
+// m_trackMutex is held, so m_openedFast belongs to this start
+void AudioEngine::recordTrackStart(double openMs, double totalMs) {
+    {
+        std::lock_guard<std::mutex> lock(m_startStatsMutex);
+        TrackStartStats& stats = m_startStats;
+        stats.starts++;
+        if (m_openedFast) stats.fastStarts++;
+        stats.lastMs = totalMs;
+        stats.lastOpenMs = openMs;
+        stats.meanMs += (totalMs - stats.meanMs) / double(stats.starts);
+        stats.worstMs = std::max(stats.worstMs, totalMs);
+    }
+    LOG_INFO("Time to first audio: " << totalMs << " ms (open " << openMs << " ms"
+             << (m_openedFast ? ", header only)" : ")"));
+}
+
+AudioEngine::TrackStartStats AudioEngine::trackStartStats() const {
+    std::lock_guard<std::mutex> lock(m_startStatsMutex);
+    return m_startStats;
+}
+
+// Drops audio decoded for the previous track or position; m_trackMutex is held
+void AudioEngine::resetFeed() {
+    if (m_ring) m_ring->clear();
+    m_spareCount = 0;
+    m_decoderAtEnd = false;
+}
+
+// Real-time mode: decodes ahead into the ring at normal priority. Demuxer I/O,
+// allocations and waiting for the track mutex all happen here. Also reports
+// the feeder's deadline misses, which it cannot print itself.
+void AudioEngine::decoderThread() {
+    AllocScope alloc(AllocTag::Audio);
+    std::vector<int16_t> block(BUFFER_SAMPLES * 2);
+    uint64_t reportedMisses = 0;
+    auto lastReport = std::chrono::steady_clock::now();
+
+    while (m_running) {
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastReport > std::chrono::seconds(5)) {
+            lastReport = now;
+            DeadlineStats stats = deadlineStats();
+            if (stats.nearMisses + stats.underruns != reportedMisses) {
+                reportedMisses = stats.nearMisses + stats.underruns;
+                LOG_WARNING("Audio deadline watchdog: " << stats.nearMisses << " near misses, "
+                            << stats.underruns << " underruns in " << stats.refills
+                            << " refills (worst margin " << stats.worstMarginMs << " ms)");
+            }
+        }
+
+        if (!m_playing || m_trackSwitchRequested || m_ring->space() < BUFFER_SAMPLES) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            continue;
+        }
+
+        bool decodedBlock = false;
+        bool trackEnded = false;
+        {
+            std::lock_guard<std::mutex> lock(m_trackMutex);
+            if (m_playing && !m_trackSwitchRequested) {
+                if (!m_decoderAtEnd) {
+                    int decoded = decodeNextBlock(block.data(), BUFFER_SAMPLES);
+                    if (decoded > 0) m_ring->push(block.data(), static_cast<size_t>(decoded));
+                    else m_decoderAtEnd = true;
+                    decodedBlock = decoded > 0;
+                }
+                // Everything decoded has been played
+                trackEnded = m_decoderAtEnd && m_ring->available() == 0 && m_spareCount == NUM_BUFFERS;
+            }
+        }
+
+        if (trackEnded) playNext();
+        else if (!decodedBlock) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+}
+
 // Return current file path
 std::string AudioEngine::currentFile() const {
-    return m_currentFile;
+    return playbackState()->currentFile;
+}
+
+std::shared_ptr<const PlaybackState> AudioEngine::playbackState() const {
+    return std::atomic_load(&m_playback);
 }
 
 // Fetch metadata of current track
 std::optional<AudioMetadata> AudioEngine::currentMetadata() const {
-    if (m_currentFile.empty()) return std::nullopt;
-    auto map = AddAudioFile(m_currentFile);
-    auto it = map.find(m_currentFile);
+    std::string file = currentFile();
+    if (file.empty()) return std::nullopt;
+    auto map = AddAudioFile(file);
+    auto it = map.find(file);
     if (it != map.end()) return it->second;
     return std::nullopt;
 }
@@ -315,8 +674,15 @@ void AudioEngine::setVolume(float v) {
     alSourcef(m_source, AL_GAIN, v);
 }
 
+void AudioEngine::setSpeed(float speed) {
+    // Picked up by the next decoded block; what the device has queued plays out first
+    m_speed.store(std::clamp(speed, TimeStretch::MIN_SPEED, TimeStretch::MAX_SPEED));
+    notifyStateChanged();
+}
+
 // Seek to position in seconds
 void AudioEngine::seek(double seconds) {
+    AllocScope alloc(AllocTag::Audio);
     if (!m_fmt || !m_codec) return;
 
     if (seconds < 0) seconds = 0;
@@ -327,8 +693,6 @@ void AudioEngine::seek(double seconds) {
 
         m_trackSwitchRequested = true;
 
-        m_playedSamples = seconds * m_codec->sample_rate;
-
         alSourceStop(m_source);
 
         // Clear queued buffers
@@ -338,15 +702,14 @@ void AudioEngine::seek(double seconds) {
             ALuint buf;
             alSourceUnqueueBuffers(m_source, 1, &buf);
         }
+        resetFeed();
 
         // Seek FFmpeg stream
-        int64_t ts = static_cast<int64_t>(seconds / av_q2d(m_fmt->streams[m_streamIdx]->time_base));
-        if (av_seek_frame(m_fmt, m_streamIdx, ts, AVSEEK_FLAG_BACKWARD) < 0) {
-            std::cerr << "Failed to seek audio\n";
+        if (!seekStream(seconds)) {
+            LOG_ERROR("Failed to seek audio");
             m_trackSwitchRequested = false;
             return;
         }
-        avcodec_flush_buffers(m_codec);
 
         // Refill buffers
         for (int i = 0; i < NUM_BUFFERS; ++i) {
@@ -368,107 +731,242 @@ void AudioEngine::seek(double seconds) {
     }
 
     m_switchCv.notify_one(); // wake worker
+    notifyStateChanged();
+    prefetchUpcoming();
+}
+
+uint64_t AudioEngine::PrefetchBudget() {
+    if (const char* mb = std::getenv("VESPER_PREFETCH_MB")) {
+        long value = std::strtol(mb, nullptr, 10);
+        if (value >= 0) return uint64_t(value) * 1024 * 1024;
+    }
+    return FilePrefetcher::DEFAULT_BUDGET;
+}
+
+void AudioEngine::prefetchUpcoming() {
+    auto state = playbackState();
+    if (state->currentFile.empty()) return;
+
+    std::vector<std::string> paths{ state->currentFile };
+    std::vector<TrackId> upcoming = upcomingTracks(PREFETCH_TRACKS);
+    auto library = GetLibrary(); // after the ids, so it knows all of them
+    for (TrackId id : upcoming) paths.push_back(library->path(id));
+
+    double duration = m_duration.load();
+    m_prefetcher.prefetch(std::move(paths), duration > 0.0 ? m_position.load() / duration : 0.0);
 }
 
 void AudioEngine::AddFilesFromDirectory(const std::string& directory) {
-    auto newMetadata = ::AddAudioFilesFromDirectory(directory); // scan directory
-    for (auto& [path, meta] : newMetadata) {
-        if (std::find(audioFiles.begin(), audioFiles.end(), path) == audioFiles.end()) {
-            audioFiles.push_back(path); // add path
-            metadataCache[path] = meta; // add metadata
+    AddFiles(::ListAudioFiles(directory));
+}
+
+void AudioEngine::AddFiles(std::vector<std::string> paths) {
+    AllocScope alloc(AllocTag::Library);
+    std::vector<std::pair<std::string, AudioMetadata>> files;
+    files.reserve(paths.size());
+    for (std::string& path : paths) files.emplace_back(std::move(path), AudioMetadata{});
+
+    // New ids are appended in order, after everything already known
+    std::vector<std::pair<TrackId, std::string>> added;
+    updateLibrary([&](Library& library) {
+        // Queued files the user now adds for real are saved from here on
+        if (!m_unsavedTracks.empty()) {
+            for (const auto& file : files) m_unsavedTracks.erase(library.find(file.first));
         }
+        size_t first = library.size();
+        library.add(std::move(files)); // skips known paths
+        for (size_t id = first; id < library.size(); ++id)
+            added.emplace_back(static_cast<TrackId>(id), library.path(static_cast<TrackId>(id)));
+    });
+    if (added.empty()) return;
+    m_tagScanner.enqueue(std::move(added));
+    saveLibraryDatabase(); // the new rows survive even if the scan does not finish
+}
+
+void AudioEngine::publishTags(TagScanner::Results&& results, bool finished) {
+    updateLibrary([&](Library& library) { library.updateMetadata(results); });
+    m_libraryDirty = true;
+    if (finished) saveLibraryDatabase(); // tags complete, worth keeping
+}
+void AudioEngine::SaveLibraryOnExit() {
+    // Files being read when the scan stops still get their tags in
+    m_tagScanner.stop();
+    m_tagScanner.wait(std::chrono::seconds(2));
+    if (m_libraryDirty) saveLibraryDatabase();
+}
+void AudioEngine::saveLibraryDatabase() {
+    // The snapshot and the unsaved set are taken together
+    std::shared_ptr<const Library> library;
+    std::unordered_set<TrackId> unsaved;
+    {
+        std::lock_guard<std::mutex> lock(m_libraryWriteMutex);
+        m_libraryDirty = false;
+        library = GetLibrary();
+        unsaved = m_unsavedTracks;
     }
+    ::SaveLibraryDatabase(*library, unsaved);
 }
 void AudioEngine::AddFile(const std::string& filePath) {
-    auto newMetadata = ::AddAudioFile(filePath); // get metadata
-    for (auto& [path, meta] : newMetadata) {
-        if (std::find(audioFiles.begin(), audioFiles.end(), path) == audioFiles.end()) {
-            audioFiles.push_back(path); // add path
-            metadataCache[path] = meta; // add metadata
-        }
-    }
+    auto tracks = ::AddAudioFile(filePath); // get metadata
+    updateLibrary([&](Library& library) {
+        for (const auto& track : tracks) m_unsavedTracks.erase(library.find(track.first));
+        library.add(tracks);
+    });
+    saveLibraryDatabase();
 }
-
-const std::vector<std::string>& AudioEngine::GetAudioFiles() const {
-    return audioFiles;
+void AudioEngine::AddTracks(const std::unordered_map<std::string, AudioMetadata>& tracks) {
+    updateLibrary([&](Library& library) { library.add(tracks); });
+}
+bool AudioEngine::LoadLibraryDatabase() {
+    bool loaded = false;
+    updateLibrary([&](Library& library) { loaded = ::LoadLibraryDatabase(library); });
+    return loaded;
 }
 
-const std::unordered_map<std::string, AudioMetadata>& AudioEngine::GetMetadataCache() const {
-    return metadataCache;
+std::shared_ptr<const Library> AudioEngine::GetLibrary() const {
+    return std::atomic_load(&m_library);
 }
 
 
-void AudioEngine::playTrackAtIndex(int index)
+void AudioEngine::playTrackAtIndex(TrackId index)
 {
-    if (index < 0 || index >= static_cast<int>(audioFiles.size()))
+    auto library = GetLibrary();
+    if (index >= library->size())
         return;
 
-    const std::string& path = audioFiles[index];
-    loadAndPlay(path);
+    loadAndPlay(library->path(index));
 }
 
 void AudioEngine::playNext()
 {
-    if (audioFiles.empty()) return;
+    TrackId nextIndex = INVALID_TRACK;
+    bool finished = false;
 
-    int nextIndex = -1;
+    updatePlayback([&](PlaybackState& state) {
+        // Taken after the state, so it knows every id the state can refer to
+        auto library = GetLibrary();
+        if (library->empty()) return;
 
-    if (m_repeatOne.load()) {
-        nextIndex = m_currentIndex.load();
-        if (nextIndex < 0) nextIndex = 0;
-    }
-    if (m_shuffle.load() && !m_shuffleQueue.empty()) {
-        size_t pos = m_queuePos.load();
-        if (pos + 1 < m_shuffleQueue.size()) {
-            nextIndex = m_shuffleQueue[pos + 1];
-            m_queuePos.store(pos + 1);
+        TrackId current = state.currentTrack;
+        if (m_repeatOne.load()) {
+            nextIndex = current != INVALID_TRACK ? current : 0;
+        }
+        if (m_shuffle.load() && state.shuffle) {
+            growShuffleOrder(state, *library);
+            size_t size = shuffleSize(state, *library);
+            uint64_t from = current == INVALID_TRACK ? state.shuffleStep : state.shuffleStep + 1;
+            uint64_t step = state.shuffle->next(from, size);
+            if (step < state.shuffle->steps()) {
+                state.shuffleStep = step;
+                if (state.playlist) state.playlistPos = static_cast<size_t>(state.shuffle->at(step));
+                nextIndex = shuffleTrack(state, state.shuffle->at(step));
+            }
+            else {
+                state.shuffleStep = state.shuffle->steps();
+                finished = true;
+            }
+        }
+        else if (state.playlist) {
+            size_t nextPos = current == INVALID_TRACK ? 0 : state.playlistPos + 1;
+            if (nextPos >= state.playlist->tracks.size()) {
+                finished = true;
+            }
+            else {
+                state.playlistPos = nextPos;
+                nextIndex = state.playlist->tracks[nextPos];
+            }
         }
         else {
-            stop();
-            m_currentIndex.store(-1);
-            return;
+            const auto& order = library->order(m_sortColumn.load());
+            size_t rank = current == INVALID_TRACK ? order.size() : library->rankOf(m_sortColumn.load(), current);
+            size_t nextRank = rank < order.size() ? rank + 1 : 0;
+            if (current != INVALID_TRACK && nextRank >= order.size()) {
+                finished = true;
+            }
+            else {
+                nextIndex = order[nextRank];
+            }
         }
+
+        if (finished) state.currentTrack = INVALID_TRACK;
+    });
+
+    if (finished) {
+        std::lock_guard<std::mutex> lock(m_trackMutex); // the feeder may be refilling
+        stop();
+        return;
+    }
+    if (nextIndex == INVALID_TRACK || m_trackSwitchRequested.load()) return;
+    playTrackAtIndex(nextIndex);
+}
+
+std::vector<TrackId> AudioEngine::upcomingTracks(size_t count) const
+{
+    std::vector<TrackId> upcoming;
+    auto state = playbackState();
+    auto library = GetLibrary();
+    if (library->empty() || m_repeatOne.load()) return upcoming;
+
+    if (m_shuffle.load() && state->shuffle) {
+        const ShuffleOrder& order = *state->shuffle;
+        size_t size = std::min<uint64_t>(shuffleSize(*state, *library), order.steps());
+        uint64_t step = state->currentTrack == INVALID_TRACK ? state->shuffleStep : state->shuffleStep + 1;
+        for (step = order.next(step, size); step < order.steps() && upcoming.size() < count; step = order.next(step + 1, size))
+            upcoming.push_back(shuffleTrack(*state, order.at(step)));
+    }
+    else if (state->playlist) {
+        size_t pos = state->currentTrack == INVALID_TRACK ? 0 : state->playlistPos + 1;
+        for (; pos < state->playlist->tracks.size() && upcoming.size() < count; ++pos)
+            upcoming.push_back(state->playlist->tracks[pos]);
     }
     else {
-        int current = m_currentIndex.load();
-        nextIndex = current + 1;
-        if (nextIndex >= static_cast<int>(audioFiles.size())) {
-            stop();
-            m_currentIndex.store(-1);
-            return;
-        }
+        const auto& order = library->order(m_sortColumn.load());
+        TrackId current = state->currentTrack;
+        size_t rank = current == INVALID_TRACK ? 0 : library->rankOf(m_sortColumn.load(), current) + 1;
+        for (; rank < order.size() && upcoming.size() < count; ++rank)
+            upcoming.push_back(order[rank]);
     }
-
-    if (m_trackSwitchRequested.load()) return;
-    playTrackAtIndex(nextIndex);
+    return upcoming;
 }
 
 void AudioEngine::playPrev()
 {
-    if (audioFiles.empty()) return;
+    TrackId prevIndex = INVALID_TRACK;
 
-    int prevIndex = -1;
+    updatePlayback([&](PlaybackState& state) {
+        auto library = GetLibrary();
+        if (library->empty()) return;
 
-    if (m_repeatOne.load()) {
-        prevIndex = m_currentIndex.load();
-        if (prevIndex < 0) prevIndex = 0;
-    }
-    if (m_shuffle.load() && !m_shuffleQueue.empty()) {
-        size_t pos = m_queuePos.load();
-        if (pos > 0) {
-            prevIndex = m_shuffleQueue[pos - 1];
-            m_queuePos.store(pos - 1);
+        TrackId current = state.currentTrack;
+        if (m_repeatOne.load()) {
+            prevIndex = current != INVALID_TRACK ? current : 0;
+        }
+        if (m_shuffle.load() && state.shuffle) {
+            growShuffleOrder(state, *library);
+            size_t size = shuffleSize(state, *library);
+            uint64_t step = state.shuffle->prev(state.shuffleStep, size);
+            if (step >= state.shuffle->steps()) step = state.shuffle->next(0, size); // at the start already
+            if (step >= state.shuffle->steps()) return;
+            state.shuffleStep = step;
+            if (state.playlist) state.playlistPos = static_cast<size_t>(state.shuffle->at(step));
+            prevIndex = shuffleTrack(state, state.shuffle->at(step));
+        }
+        else if (state.playlist) {
+            const auto& tracks = state.playlist->tracks;
+            if (tracks.empty()) return;
+            size_t pos = state.playlistPos;
+            state.playlistPos = (pos == 0 || pos >= tracks.size()) ? 0 : pos - 1;
+            prevIndex = tracks[state.playlistPos];
         }
         else {
-            prevIndex = m_shuffleQueue[0];
+            const auto& order = library->order(m_sortColumn.load());
+            size_t rank = current == INVALID_TRACK ? 0 : library->rankOf(m_sortColumn.load(), current);
+            size_t prevRank = (rank == 0 || rank >= order.size()) ? 0 : rank - 1;
+            prevIndex = order[prevRank];
         }
-    }
-    else {
-        int current = m_currentIndex.load();
-        prevIndex = (current <= 0) ? 0 : current - 1;
-    }
+    });
 
-    if (m_trackSwitchRequested.load()) return;
+    if (prevIndex == INVALID_TRACK || m_trackSwitchRequested.load()) return;
     playTrackAtIndex(prevIndex);
 }
 
@@ -477,29 +975,181 @@ void AudioEngine::setShuffle(bool enabled)
     if (m_shuffle.load() == enabled) return;
 
     m_shuffle.store(enabled);
+    updatePlayback([&](PlaybackState& state) { rebuildShuffleOrder(state, *GetLibrary()); });
+    prefetchUpcoming();
+}
+
+size_t AudioEngine::shuffleSize(const PlaybackState& state, const Library& library)
+{
+    return state.playlist ? state.playlist->tracks.size() : library.size();
+}
+
+TrackId AudioEngine::shuffleTrack(const PlaybackState& state, uint64_t index)
+{
+    return state.playlist ? state.playlist->tracks[index] : static_cast<TrackId>(index);
+}
+
+void AudioEngine::rebuildShuffleOrder(PlaybackState& state, const Library& library) const
+{
+    state.shuffleStep = 0;
+    if (!m_shuffle.load()) {
+        state.shuffle.reset();
+        return;
+    }
+
+    // The current track comes first, so the rest of the order is still to play
+    size_t first = SIZE_MAX;
+    if (state.playlist) {
+        const auto& tracks = state.playlist->tracks;
+        if (state.playlistPos < tracks.size() && tracks[state.playlistPos] == state.currentTrack) first = state.playlistPos;
+    }
+    else if (state.currentTrack != INVALID_TRACK) {
+        first = state.currentTrack;
+    }
+    state.shuffle = ShuffleOrder::Create(shuffleSize(state, library), first);
+}
+
+void AudioEngine::growShuffleOrder(PlaybackState& state, const Library& library) const
+{
+    if (!state.shuffle || state.shuffle->fits(shuffleSize(state, library))) return;
+    rebuildShuffleOrder(state, library);
+}
+
+bool AudioEngine::LoadPlaylist(const std::string& name)
+{
+    // Entries the library does not know yet are added to it
+    std::optional<Playlist> playlist;
+    updateLibrary([&](Library& library) { playlist = ::LoadPlaylist(name, library); });
+    if (!playlist) return false;
+
+    auto shared = std::make_shared<const Playlist>(std::move(*playlist));
+    updatePlayback([&](PlaybackState& state) {
+        state.playlist = shared;
+        state.playlistPos = 0;
+        rebuildShuffleOrder(state, *GetLibrary());
+    });
+    prefetchUpcoming();
+    return true;
+}
 
-    if (enabled) {
-        m_shuffleQueue.resize(audioFiles.size());
-        for (size_t i = 0; i < audioFiles.size(); ++i) {
-            m_shuffleQueue[i] = static_cast<int>(i);
+void AudioEngine::SetQueue(const std::string& name, const std::vector<std::string>& paths)
+{
+    // Unknown files are listed under their names at once, like an added
+    // folder, and their tags are read in the background
+    Playlist playlist{ name, {} };
+    std::vector<std::pair<TrackId, std::string>> added;
+    updateLibrary([&](Library& library) {
+        for (const std::string& path : paths) {
+            size_t known = library.size();
+            TrackId id = library.add(path, AudioMetadata{}); // finds known paths
+            if (library.size() > known) {
+                added.emplace_back(id, path);
+                m_unsavedTracks.insert(id); // played, not added to the library
+            }
+            playlist.tracks.push_back(id);
         }
+    });
+    m_tagScanner.enqueue(std::move(added));
+
+    auto shared = std::make_shared<const Playlist>(std::move(playlist));
+    updatePlayback([&](PlaybackState& state) {
+        state.playlist = shared;
+        state.playlistPos = 0;
+        rebuildShuffleOrder(state, *GetLibrary());
+    });
+    prefetchUpcoming();
+}
 
-        // Fisher-Yates shuffle
-        auto seed = std::chrono::high_resolution_clock::now().time_since_epoch().count();
-        std::mt19937 rng(static_cast<unsigned>(seed));
-        std::shuffle(m_shuffleQueue.begin(), m_shuffleQueue.end(), rng);
+bool AudioEngine::SavePlaylist(const std::string& name)
+{
+    // Saves what the track list currently shows
+    auto library = GetLibrary();
+    auto active = GetActivePlaylist();
+    Playlist playlist{ name, active ? active->tracks : library->order(m_sortColumn.load()) };
+    if (!::SavePlaylist(playlist, *library)) return false;
+
+    if (active) {
+        auto renamed = std::make_shared<const Playlist>(std::move(playlist));
+        updatePlayback([&](PlaybackState& state) {
+            if (state.playlist == active) state.playlist = renamed;
+        });
+    }
+    return true;
+}
+
+void AudioEngine::ShowLibrary()
+{
+    updatePlayback([&](PlaybackState& state) {
+        state.playlist.reset();
+        state.playlistPos = 0;
+        rebuildShuffleOrder(state, *GetLibrary());
+    });
+    prefetchUpcoming();
+}
+
+std::shared_ptr<const Playlist> AudioEngine::GetActivePlaylist() const
+{
+    return playbackState()->playlist;
+}
 
-        int current = m_currentIndex.load();
-        auto it = std::find(m_shuffleQueue.begin(), m_shuffleQueue.end(), current);
-        if (it != m_shuffleQueue.end()) {
-            m_queuePos.store(std::distance(m_shuffleQueue.begin(), it));
+void AudioEngine::playPlaylistEntry(size_t pos)
+{
+    TrackId id = INVALID_TRACK;
+    updatePlayback([&](PlaybackState& state) {
+        if (!state.playlist || pos >= state.playlist->tracks.size()) return;
+        state.playlistPos = pos;
+        id = state.playlist->tracks[pos];
+    });
+    if (id != INVALID_TRACK) playTrackAtIndex(id);
+}
+
+Session AudioEngine::captureSession() const
+{
+    auto state = playbackState();
+    Session session;
+    session.currentFile = state->currentFile;
+    session.position = m_position.load();
+    session.volume = m_volume.load();
+    session.shuffle = m_shuffle.load();
+    session.repeatOne = m_repeatOne.load();
+    session.sortColumn = m_sortColumn.load();
+    if (state->playlist) session.playlist = *state->playlist;
+    session.playlistPos = state->playlistPos;
+    session.shuffleOrder = state->shuffle;
+    session.shuffleStep = state->shuffleStep;
+    return session;
+}
+
+void AudioEngine::restoreSession(const Session& session)
+{
+    m_shuffle.store(session.shuffle);
+    m_repeatOne.store(session.repeatOne);
+    m_sortColumn.store(session.sortColumn);
+    if (m_device) setVolume(session.volume);
+    else m_volume.store(std::clamp(session.volume, 0.0f, 2.0f));
+
+    auto library = GetLibrary();
+    // Ids from a library database that has since been replaced are dropped
+    auto known = [&](const std::vector<TrackId>& ids) {
+        return std::all_of(ids.begin(), ids.end(), [&](TrackId id) { return id < library->size(); });
+    };
+
+    updatePlayback([&](PlaybackState& state) {
+        state.playlist.reset();
+        state.playlistPos = 0;
+        if (session.playlist && known(session.playlist->tracks)) {
+            state.playlist = std::make_shared<const Playlist>(*session.playlist);
+            state.playlistPos = std::min(session.playlistPos, session.playlist->tracks.size());
+        }
+        state.currentTrack = library->find(session.currentFile);
+
+        // The same order, so the tracks still to come are the ones that were
+        if (session.shuffle && session.shuffleOrder && session.shuffleOrder->fits(shuffleSize(state, *library))) {
+            state.shuffle = session.shuffleOrder;
+            state.shuffleStep = std::min(session.shuffleStep, state.shuffle->steps());
         }
         else {
-            m_queuePos.store(0);
+            rebuildShuffleOrder(state, *library);
         }
-    }
-    else {
-        m_shuffleQueue.clear();
-        m_queuePos.store(0);
-    }
+    });
 }
\ No newline at end of file
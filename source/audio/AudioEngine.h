@@ -7,8 +7,10 @@
 #include <functional>
 #include <optional>
 #include <vector>
+#include <unordered_set>
 #include <queue>
 #include <condition_variable>
+#include <memory>
 
 extern "C" {
 #include <libavformat/avformat.h>
@@ -19,49 +21,177 @@ extern "C" {
 #include <al.h>
 #include <alc.h>
 #include "files.h"
+#include "Library.h"
+#include "Playlist.h"
+#include "LibraryDatabase.h"
+#include "Session.h"
+#include "TagScanner.h"
+#include "FilePrefetcher.h"
+#include "PcmRing.h"
+#include "TimeStretch.h"
+#include "MediaOpen.h"
+
+// What is playing and what plays next. Published as an immutable snapshot:
+// writers copy, change and swap the pointer, readers never take a lock.
+struct PlaybackState {
+    uint64_t version = 0;
+    std::string currentFile;
+    TrackId currentTrack = INVALID_TRACK;           // also INVALID_TRACK for files outside the library
+    std::shared_ptr<const Playlist> playlist;       // null while the library is shown
+    size_t playlistPos = 0;
+    std::optional<ShuffleOrder> shuffle;            // unset unless shuffle is on
+    uint64_t shuffleStep = 0;                       // step of the track the order played last
+};
 
 class AudioEngine {
 public:
     AudioEngine();
     ~AudioEngine();
 
-    void loadAndPlay(const std::string& filePath);
+    // Opens the audio device and starts streaming; throws if there is no device.
+    // Must finish before anything is played.
+    void init();
+
+    // Opt-in, before init(): a high-priority feeder thread only moves decoded
+    // audio into the device, while a separate thread decodes ahead into a ring
+    void setRealtime(bool enabled) { m_realtime = enabled; }
+    bool realtime() const { return m_realtime; }
+
+    // How close real-time refills came to the device queue running dry.
+    // Underruns are also counted without real-time mode.
+    struct DeadlineStats {
+        uint64_t refills = 0;
+        uint64_t nearMisses = 0; // less than one buffer of audio was left
+        uint64_t underruns = 0;  // the queue ran dry and playback stopped
+        double worstMarginMs = 0.0;
+    };
+    DeadlineStats deadlineStats() const;
+
+    // On by default, VESPER_FAST_OPEN=0 turns it off: tracks open with a named
+    // demuxer and bounded probing, falling back to a full probe if that fails
+    void setFastOpen(bool enabled) { m_fastOpen.store(enabled); }
+    bool fastOpen() const { return m_fastOpen.load(); }
+
+    // Time from a play request to the first audio handed to the device
+    struct TrackStartStats {
+        uint64_t starts = 0;
+        uint64_t fastStarts = 0; // opened without a stream-info pass
+        double lastMs = 0.0;
+        double lastOpenMs = 0.0; // part of lastMs spent opening the file
+        double meanMs = 0.0;
+        double worstMs = 0.0;
+    };
+    TrackStartStats trackStartStats() const;
+
+    // False if the file could not be opened; true once it is the current track
+    bool loadAndPlay(const std::string& filePath);
+    // Opens a track paused at `seconds` with the device queue already filled,
+    // so play() starts it at once
+    void cue(const std::string& filePath, double seconds);
     void play();
     void pause();
     void playPause();
     void stop();
     void seek(double seconds);
     void setVolume(float v);
+    // 0.5 to 2.0; changes the tempo, not the pitch. Position and duration stay in track time.
+    void setSpeed(float speed);
 
     void playNext();
     void playPrev();
 
+    // Tracks playNext() would pick after the current one, in order
+    std::vector<TrackId> upcomingTracks(size_t count) const;
+
     void setRepeatOne(bool enabled) { m_repeatOne.store(enabled); }
     void setShuffle(bool enabled);
 
     bool getRepeatOne() const { return m_repeatOne.load(); }
     bool getShuffle() const { return m_shuffle.load(); }
 
+    // Next/prev follow the order the list is displayed in
+    void setSortColumn(SortColumn column) { m_sortColumn.store(column); }
+    SortColumn getSortColumn() const { return m_sortColumn.load(); }
+
     bool isPlaying() const { return m_playing.load(); }
     double position() const { return m_position.load(); }
     double duration() const { return m_duration.load(); }
     float volume() const { return m_volume.load(); }
+    float speed() const { return m_speed.load(); }
     std::string currentFile() const;
+    // Consistent view for one frame; stays valid however playback moves on
+    std::shared_ptr<const PlaybackState> playbackState() const;
+
+    // Bumped whenever playback changes on its own or through a call:
+    // track, play/pause, stop, seek. The listener runs on whichever thread
+    // made the change, so it should only wake the UI.
+    uint64_t stateVersion() const { return m_stateVersion.load(); }
+    void setStateListener(std::function<void()> listener);
     std::optional<AudioMetadata> currentMetadata() const;
 
+    // Lists the files at once under their names; tags are read in the background
     void AddFilesFromDirectory(const std::string& directory);
+    // Same for files already listed, e.g. with ListAudioFiles
+    void AddFiles(std::vector<std::string> paths);
     void AddFile(const std::string& filePath);
-    const std::vector<std::string>& GetAudioFiles() const;
-    const std::unordered_map<std::string, AudioMetadata>& GetMetadataCache() const;
+    // Tracks whose tags are already known, e.g. a synthetic benchmark library
+    void AddTracks(const std::unordered_map<std::string, AudioMetadata>& tracks);
+    // Restores the library saved on the last scan; safe to run alongside init()
+    bool LoadLibraryDatabase();
+    // At exit: stops reading tags and saves the library if the database lags
+    // behind, so a folder added during a long scan is not lost
+    void SaveLibraryOnExit();
+    // Snapshot of the library; adding tracks publishes a new one
+    std::shared_ptr<const Library> GetLibrary() const;
+    // Tracks still waiting for their tags; the visible ones are read first
+    size_t pendingTags() const { return m_tagScanner.pending(); }
+    void prioritizeTags(const std::vector<TrackId>& visible) { m_tagScanner.prioritize(visible); }
+    // Without a GUI to keep responsive, a scan can use every background worker
+    void setTagJobs(size_t jobs) { m_tagScanner.setMaxJobs(jobs); }
+    bool waitForTags(std::chrono::milliseconds timeout) { return m_tagScanner.wait(timeout); }
+
+    // While a playlist is active the track list and next/prev follow it
+    bool LoadPlaylist(const std::string& name);
+    // An unsaved playlist of the given files, e.g. named on the command line.
+    // Files new to the library get their tags read in the background.
+    void SetQueue(const std::string& name, const std::vector<std::string>& paths);
+    bool SavePlaylist(const std::string& name);
+    void ShowLibrary();
+    std::shared_ptr<const Playlist> GetActivePlaylist() const;
+    void playPlaylistEntry(size_t pos);
+
+    // Playback side of the session file; the view fields are left to the GUI
+    Session captureSession() const;
+    // Puts back queue, shuffle order and settings at once. The track itself
+    // is left to cue(), which may run in the background.
+    void restoreSession(const Session& session);
 
 private:
     static constexpr int NUM_BUFFERS = 4;
     static constexpr size_t BUFFER_SAMPLES = 8192;
     static constexpr size_t FFT_SIZE = 2048;
+    static constexpr size_t PREFETCH_TRACKS = 3; // read ahead after the current one
+    static constexpr size_t RING_FRAMES = BUFFER_SAMPLES * 4; // decoded ahead in real-time mode
 
     void workerThread();
+    void realtimeFeederThread();
+    void decoderThread();
+    void feedDevice();
+    void resetFeed();
+    void recordRefill(double margin, double bufferSeconds, bool underrun);
+    void notifyStateChanged();
+    // Copy, change and publish; concurrent writers are serialized
+    void updateLibrary(const std::function<void(Library&)>& change);
+    void updatePlayback(const std::function<void(PlaybackState&)>& change);
     bool openFile(const std::string& path);
+    bool openStream(const std::string& path, bool fast);
+    void recordTrackStart(double openMs, double totalMs);
+    bool openTrack(const std::string& filePath, double startSeconds, bool startPlaying);
+    bool seekStream(double seconds);
+    int dropBeforeSeekTarget(const AVFrame* frame, int16_t* samples, int count);
+    int decodeSourceBlock(int16_t* outBuffer, int maxSamples);
     int decodeNextBlock(int16_t* outBuffer, int maxSamples);
+    double sourceSeconds(double offsetSec);
     ALenum formatFromChannels(int channels);
 
     ALCdevice* m_device{nullptr};
@@ -76,6 +206,7 @@ private:
     int m_channels{2};
 
     std::thread m_thread;
+    std::thread m_decoderThread; // real-time mode only
     std::atomic<bool> m_running{true};
     std::atomic<bool> m_playing{false};
     std::atomic<double> m_position{0.0};
@@ -84,23 +215,79 @@ private:
     std::mutex m_trackMutex;
     std::condition_variable m_switchCv;
     std::atomic<bool> m_trackSwitchRequested{false};
-    
-    std::string m_currentFile;
+
+    std::atomic<uint64_t> m_stateVersion{0};
+    std::mutex m_listenerMutex;
+    std::function<void()> m_stateListener;
 
     std::vector<int16_t> m_decodeBuffer;
 
-    double m_playedSamples = 0.0;
+    double m_playedSamples = 0.0;    // output frames played since the last open or seek
+    int64_t m_seekTargetSample = -1; // decoding drops samples before this one
+    std::atomic<int> m_sampleRate{0};
+
+    // Time-stretch between decoder and device, used with m_trackMutex held.
+    // The clock turns output frames played back into track time.
+    std::atomic<float> m_speed{1.0f};
+    TimeStretch m_stretch;
+    StretchClock m_clock;
+    std::vector<int16_t> m_sourceBlock;
+    double m_sourceOrigin = 0.0; // track frame the stretcher started at
+    double m_outputFrames = 0.0; // frames it has produced since
+    bool m_sourceAtEnd = false;
 
+    // Real-time mode. Buffers are allocated and locked in init(); the spare
+    // buffers and the end flag are only touched with m_trackMutex held.
+    bool m_realtime = false;
+    std::unique_ptr<PcmRing> m_ring;
+    std::vector<int16_t> m_feedBuffer;
+    ALuint m_spareBuffers[NUM_BUFFERS]{0}; // played, waiting for decoded audio
+    int m_spareCount = 0;
+    bool m_decoderAtEnd = false;
+    std::atomic<uint64_t> m_refills{0};
+    std::atomic<uint64_t> m_nearMisses{0};
+    std::atomic<uint64_t> m_underruns{0};
+    std::atomic<double> m_worstMargin{-1.0}; // seconds, negative until the first refill
 
-    std::vector<std::string> audioFiles;
-    std::unordered_map<std::string, AudioMetadata> metadataCache;
-    std::atomic<int> m_currentIndex{-1};
+    static bool FastOpenDefault();
+    std::atomic<bool> m_fastOpen{ FastOpenDefault() };
+    bool m_openedFast = false; // the last openFile() skipped stream info; m_trackMutex is held
+    mutable std::mutex m_startStatsMutex;
+    TrackStartStats m_startStats;
 
-    void playTrackAtIndex(int index);
+
+    // Read with std::atomic_load, replaced with std::atomic_store
+    std::shared_ptr<const Library> m_library = std::make_shared<const Library>();
+    std::shared_ptr<const PlaybackState> m_playback = std::make_shared<const PlaybackState>();
+    std::mutex m_libraryWriteMutex;
+    // Tracks only known from SetQueue, kept out of the library database;
+    // guarded by m_libraryWriteMutex
+    std::unordered_set<TrackId> m_unsavedTracks;
+    std::atomic<bool> m_libraryDirty{ false }; // tags published since the last save
+    std::mutex m_playbackWriteMutex;
+    std::atomic<SortColumn> m_sortColumn{ SortColumn::Added };
+
+    void publishTags(TagScanner::Results&& results, bool finished);
+    void saveLibraryDatabase();
+    TagScanner m_tagScanner{ [this](TagScanner::Results&& results, bool finished) {
+        publishTags(std::move(results), finished);
+    } };
+
+    void playTrackAtIndex(TrackId index);
 
     std::atomic<bool> m_repeatOne{ false };
     std::atomic<bool> m_shuffle{ false };
 
-    std::vector<int> m_shuffleQueue;
-    std::atomic<size_t> m_queuePos{ 0 };
+    // The order runs over playlist positions while a playlist is shown, else over track ids
+    static size_t shuffleSize(const PlaybackState& state, const Library& library);
+    static TrackId shuffleTrack(const PlaybackState& state, uint64_t index);
+    void rebuildShuffleOrder(PlaybackState& state, const Library& library) const;
+    // Starts a new order from the current track once the library outgrows the old one
+    void growShuffleOrder(PlaybackState& state, const Library& library) const;
+
+    // Budget from VESPER_PREFETCH_MB, 0 turns it off
+    static uint64_t PrefetchBudget();
+    // Current track from the playback position on, then the upcoming tracks
+    void prefetchUpcoming();
+    FilePrefetcher m_prefetcher{ PrefetchBudget() };
 };
\ No newline at end of file
@@ -0,0 +1,164 @@
+#include "FilePrefetcher.h"
+#include <algorithm>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#endif
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/vfs.h>
+#include <linux/magic.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// Small steps, so a newer request (track skipped) takes over quickly
+constexpr uint64_t PREFETCH_CHUNK = 2 * 1024 * 1024;
+
+// The prefetch thread must never compete with playback or the GUI for the disk
+static void LowerIoPriority() {
+#ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN); // CPU and I/O
+#elif __APPLE__
+    setiopolicy_np(IOPOL_TYPE_DISK, IOPOL_SCOPE_THREAD, IOPOL_THROTTLE);
+#elif __linux__
+    constexpr int IOPRIO_WHO_PROCESS = 1; // with id 0: the calling thread
+    constexpr int IOPRIO_CLASS_IDLE = 3;
+    syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_CLASS_IDLE << 13);
+    setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 10);
+#endif
+}
+
+#ifdef __linux__
+// tmpfs and ramfs are memory already; reading ahead would only cost time
+static bool IsMemoryBacked(int fd) {
+    struct statfs info{};
+    if (fstatfs(fd, &info) != 0) return false;
+    return info.f_type == TMPFS_MAGIC || info.f_type == RAMFS_MAGIC;
+}
+#endif
+
+FilePrefetcher::FilePrefetcher(uint64_t budgetBytes) : m_budget(budgetBytes) {}
+
+FilePrefetcher::~FilePrefetcher() {
+    shutdown();
+}
+
+void FilePrefetcher::prefetch(std::vector<std::string> paths, double startFraction) {
+    if (m_budget.load() == 0 || paths.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) return;
+        // Started on first use, so an engine that never plays has no I/O thread
+        if (!m_thread.joinable()) m_thread = std::thread(&FilePrefetcher::run, this);
+
+        m_pending = std::move(paths);
+        m_startFraction = std::clamp(startFraction, 0.0, 1.0);
+        m_generation.fetch_add(1);
+    }
+    m_cv.notify_one();
+}
+
+void FilePrefetcher::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+        m_pending.clear();
+        m_generation.fetch_add(1);
+    }
+    m_cv.notify_one();
+    if (m_thread.joinable()) m_thread.join();
+}
+
+void FilePrefetcher::run() {
+    LowerIoPriority();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_cv.wait(lock, [this] { return !m_running || !m_pending.empty(); });
+        if (!m_running) return;
+
+        std::vector<std::string> paths;
+        paths.swap(m_pending);
+        double startFraction = m_startFraction;
+        uint64_t generation = m_generation.load();
+        lock.unlock();
+
+        uint64_t budget = m_budget.load();
+        for (size_t i = 0; i < paths.size() && budget > 0; ++i) {
+            if (m_generation.load() != generation) break;
+            uint64_t used = prefetchFile(paths[i], i == 0 ? startFraction : 0.0, budget, generation);
+            budget -= std::min(budget, used);
+        }
+
+        lock.lock();
+    }
+}
+
+uint64_t FilePrefetcher::prefetchFile(const std::string& path, double startFraction, uint64_t budget, uint64_t generation) {
+    uint64_t done = 0;
+
+#ifdef _WIN32
+    // No read-ahead hint that works on a plain handle: reading is what fills the cache
+    std::error_code ec;
+    uint64_t size = fs::file_size(fs::u8path(path), ec);
+    if (ec) return 0;
+    std::ifstream file(fs::u8path(path), std::ios::binary);
+    if (!file) return 0;
+
+    uint64_t offset = static_cast<uint64_t>(size * startFraction);
+    uint64_t end = std::min(size, offset + budget);
+    file.seekg(static_cast<std::streamoff>(offset));
+    std::vector<char> scratch(PREFETCH_CHUNK);
+    while (offset < end && m_generation.load() == generation) {
+        size_t len = static_cast<size_t>(std::min(PREFETCH_CHUNK, end - offset));
+        if (!file.read(scratch.data(), len)) break;
+        offset += len;
+        done += len;
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+
+    struct stat st{};
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return 0;
+    }
+#ifdef __linux__
+    if (IsMemoryBacked(fd)) {
+        close(fd);
+        return 0;
+    }
+#endif
+
+    uint64_t size = static_cast<uint64_t>(st.st_size);
+    uint64_t offset = static_cast<uint64_t>(size * startFraction) & ~uint64_t(4095); // page aligned
+    uint64_t end = std::min(size, offset + budget);
+    while (offset < end && m_generation.load() == generation) {
+        size_t len = static_cast<size_t>(std::min(PREFETCH_CHUNK, end - offset));
+#ifdef __APPLE__
+        struct radvisory advice{ static_cast<off_t>(offset), static_cast<int>(len) };
+        fcntl(fd, F_RDADVISE, &advice);
+#else
+        // readahead() waits for the reads to be issued, which paces this thread;
+        // filesystems that do not support it still take the hint
+        if (readahead(fd, static_cast<off64_t>(offset), len) != 0)
+            posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(len), POSIX_FADV_WILLNEED);
+#endif
+        offset += len;
+        done += len;
+    }
+    close(fd);
+#endif
+
+    return done;
+}
\ No newline at end of file
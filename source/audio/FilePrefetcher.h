@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Pulls the files that are about to play into the OS page cache on a
+// low-priority I/O thread, so the decoder's reads hit memory even on
+// spinning disks and network mounts. Nothing is kept in process memory.
+class FilePrefetcher {
+public:
+    static constexpr uint64_t DEFAULT_BUDGET = 256ull * 1024 * 1024;
+
+    explicit FilePrefetcher(uint64_t budgetBytes = DEFAULT_BUDGET);
+    ~FilePrefetcher();
+
+    FilePrefetcher(const FilePrefetcher&) = delete;
+    FilePrefetcher& operator=(const FilePrefetcher&) = delete;
+
+    // Replaces whatever is still pending. Files are warmed in the given order
+    // until the byte budget is spent; the first one from `startFraction` of its
+    // length on, which is where the current track is playing.
+    void prefetch(std::vector<std::string> paths, double startFraction = 0.0);
+
+    // 0 disables prefetching
+    void setBudget(uint64_t bytes) { m_budget.store(bytes); }
+    uint64_t budget() const { return m_budget.load(); }
+
+    void shutdown();
+
+private:
+    void run();
+    // Returns the bytes handed to the OS; stops early once the request is superseded
+    uint64_t prefetchFile(const std::string& path, double startFraction, uint64_t budget, uint64_t generation);
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<std::string> m_pending;
+    double m_startFraction = 0.0;
+    bool m_running = true;
+    std::atomic<uint64_t> m_generation{0}; // bumped by every request, so stale work stops early
+    std::atomic<uint64_t> m_budget;
+};
\ No newline at end of file
@@ -0,0 +1,99 @@
+#include "MediaOpen.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <utility>
+
+namespace {
+
+// Enough for a header and the first packets. The defaults (5 MB, 5 s) are
+// sized for containers with many streams of unknown kind.
+constexpr int64_t FAST_PROBE_BYTES = 64 * 1024;
+constexpr int64_t FAST_ANALYZE_US = 500 * 1000;
+
+const char* FormatFromMagic(const unsigned char* b, size_t n) {
+    if (n >= 4 && std::memcmp(b, "fLaC", 4) == 0) return "flac";
+    if (n >= 4 && std::memcmp(b, "OggS", 4) == 0) return "ogg";
+    if (n >= 12 && std::memcmp(b, "RIFF", 4) == 0 && std::memcmp(b + 8, "WAVE", 4) == 0) return "wav";
+    if (n >= 12 && std::memcmp(b, "FORM", 4) == 0 &&
+        (std::memcmp(b + 8, "AIFF", 4) == 0 || std::memcmp(b + 8, "AIFC", 4) == 0)) return "aiff";
+    if (n >= 8 && std::memcmp(b + 4, "ftyp", 4) == 0) return "mov";
+    if (n >= 2 && b[0] == 0xFF) {
+        if ((b[1] & 0xF6) == 0xF0) return "aac";                        // ADTS, layer 0
+        if ((b[1] & 0xE0) == 0xE0 && (b[1] & 0x06) != 0) return "mp3";  // MPEG audio frame
+    }
+    return nullptr; // an ID3 tag may front MP3, AAC or even FLAC
+}
+
+const char* FormatFromExtension(const std::string& path) {
+    static const std::pair<const char*, const char*> formats[] = {
+        { ".mp3", "mp3" }, { ".flac", "flac" }, { ".ogg", "ogg" }, { ".opus", "ogg" },
+        { ".wav", "wav" }, { ".m4a", "mov" }, { ".aac", "aac" },
+    };
+    std::string ext = std::filesystem::u8path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+    for (const auto& [suffix, name] : formats)
+        if (ext == suffix) return name;
+    return nullptr;
+}
+
+// True when the header gave everything the decoder and resampler are set up from
+bool HeaderDescribesAudio(AVFormatContext* fmt) {
+    int idx = av_find_best_stream(fmt, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+    if (idx < 0) return false;
+    const AVStream* stream = fmt->streams[idx];
+    const AVCodecParameters* par = stream->codecpar;
+    if (par->codec_id == AV_CODEC_ID_NONE || par->sample_rate <= 0 || par->ch_layout.nb_channels <= 0)
+        return false;
+
+    // These decoders are configured from extradata
+    switch (par->codec_id) {
+    case AV_CODEC_ID_AAC:
+    case AV_CODEC_ID_ALAC:
+    case AV_CODEC_ID_VORBIS:
+    case AV_CODEC_ID_OPUS:
+        if (par->extradata_size <= 0) return false;
+        break;
+    default:
+        break;
+    }
+
+    // The seek bar needs a length; without one the full pass estimates it
+    return stream->duration != AV_NOPTS_VALUE || fmt->duration != AV_NOPTS_VALUE;
+}
+
+}
+
+const AVInputFormat* GuessInputFormat(const std::string& path) {
+    unsigned char magic[12] = {};
+    std::ifstream in(std::filesystem::u8path(path), std::ios::binary);
+    in.read(reinterpret_cast<char*>(magic), sizeof(magic));
+    const char* name = FormatFromMagic(magic, static_cast<size_t>(in.gcount()));
+    if (!name) name = FormatFromExtension(path);
+    return name ? av_find_input_format(name) : nullptr;
+}
+
+MediaOpenResult OpenMediaInput(const std::string& path, bool fast) {
+    MediaOpenResult result;
+    const AVInputFormat* format = nullptr;
+    AVDictionary* options = nullptr;
+    if (fast) {
+        format = GuessInputFormat(path);
+        av_dict_set_int(&options, "probesize", FAST_PROBE_BYTES, 0);
+        av_dict_set_int(&options, "analyzeduration", FAST_ANALYZE_US, 0);
+    }
+
+    int ret = avformat_open_input(&result.fmt, path.c_str(), format, &options);
+    av_dict_free(&options);
+    if (ret < 0) return result; // the context is freed and nulled on failure
+    result.hinted = format != nullptr;
+
+    if (fast && HeaderDescribesAudio(result.fmt)) {
+        result.skippedProbe = true;
+        return result;
+    }
+    if (avformat_find_stream_info(result.fmt, nullptr) < 0) avformat_close_input(&result.fmt);
+    return result;
+}
\ No newline at end of file
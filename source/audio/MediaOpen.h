@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+// Opening a file for playback. The fast path names the demuxer from the
+// file's first bytes (or its extension), caps how much is probed and skips
+// avformat_find_stream_info when the header already describes the audio.
+struct MediaOpenResult {
+    AVFormatContext* fmt = nullptr; // null if the file could not be opened
+    bool hinted = false;            // the demuxer was named, not probed for
+    bool skippedProbe = false;      // stream parameters came from the header alone
+};
+
+// Demuxer for `path` from its magic bytes, else its extension; null if unsure
+const AVInputFormat* GuessInputFormat(const std::string& path);
+
+MediaOpenResult OpenMediaInput(const std::string& path, bool fast);
\ No newline at end of file
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+// Lock-free ring of interleaved 16-bit stereo frames between exactly one
+// producer and one consumer thread. Storage is allocated once up front, so
+// neither side ever allocates.
+class PcmRing {
+public:
+    // Rounded up to a power of two
+    explicit PcmRing(size_t frames) {
+        size_t capacity = 1;
+        while (capacity < frames) capacity <<= 1;
+        m_samples.assign(capacity * 2, 0);
+        m_mask = capacity - 1;
+    }
+
+    size_t capacity() const { return m_mask + 1; }
+    size_t available() const { return m_write.load(std::memory_order_acquire) - m_read.load(std::memory_order_relaxed); }
+    size_t space() const { return capacity() - (m_write.load(std::memory_order_relaxed) - m_read.load(std::memory_order_acquire)); }
+
+    // Producer side; returns the frames actually written
+    size_t push(const int16_t* frames, size_t count) {
+        size_t write = m_write.load(std::memory_order_relaxed);
+        count = std::min(count, capacity() - (write - m_read.load(std::memory_order_acquire)));
+        copyIn(frames, write, count);
+        m_write.store(write + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer side; returns the frames actually read
+    size_t pop(int16_t* frames, size_t count) {
+        size_t read = m_read.load(std::memory_order_relaxed);
+        count = std::min(count, m_write.load(std::memory_order_acquire) - read);
+        copyOut(frames, read, count);
+        m_read.store(read + count, std::memory_order_release);
+        return count;
+    }
+
+    // Only while neither side is running, e.g. under the track mutex
+    void clear() { m_read.store(m_write.load()); }
+
+    const void* data() const { return m_samples.data(); }
+    size_t bytes() const { return m_samples.size() * sizeof(int16_t); }
+
+private:
+    // Both copy `count` frames starting at frame `pos`, wrapping at most once
+    void copyIn(const int16_t* frames, size_t pos, size_t count) {
+        size_t start = pos & m_mask;
+        size_t first = std::min(count, capacity() - start);
+        std::memcpy(m_samples.data() + start * 2, frames, first * FRAME_BYTES);
+        std::memcpy(m_samples.data(), frames + first * 2, (count - first) * FRAME_BYTES);
+    }
+    void copyOut(int16_t* frames, size_t pos, size_t count) const {
+        size_t start = pos & m_mask;
+        size_t first = std::min(count, capacity() - start);
+        std::memcpy(frames, m_samples.data() + start * 2, first * FRAME_BYTES);
+        std::memcpy(frames + first * 2, m_samples.data(), (count - first) * FRAME_BYTES);
+    }
+
+    static constexpr size_t FRAME_BYTES = 2 * sizeof(int16_t);
+
+    std::vector<int16_t> m_samples;
+    size_t m_mask = 0;
+    std::atomic<size_t> m_read{0};  // frames consumed so far
+    std::atomic<size_t> m_write{0}; // frames produced so far
+};
\ No newline at end of file
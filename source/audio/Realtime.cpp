@@ -0,0 +1,66 @@
+#include "Realtime.h"
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif
+
+bool PromoteThreadToRealtime(std::string& error) {
+#ifdef _WIN32
+    if (SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL)) return true;
+    error = "SetThreadPriority failed";
+    return false;
+#else
+    // Low in the FIFO range: above every normal thread, below the sound server's own
+    int priority = sched_get_priority_min(SCHED_FIFO) + 9;
+
+#ifdef RLIMIT_RTPRIO
+    // Without root, the soft limit may still be raised up to the hard one,
+    // which is what limits.conf or rtkit-style setups hand out
+    rlimit limit{};
+    if (getrlimit(RLIMIT_RTPRIO, &limit) == 0) {
+        if (limit.rlim_cur != limit.rlim_max) {
+            limit.rlim_cur = limit.rlim_max;
+            setrlimit(RLIMIT_RTPRIO, &limit);
+            getrlimit(RLIMIT_RTPRIO, &limit);
+        }
+        if (limit.rlim_cur != RLIM_INFINITY && static_cast<rlim_t>(priority) > limit.rlim_cur)
+            priority = static_cast<int>(limit.rlim_cur);
+    }
+    if (priority < sched_get_priority_min(SCHED_FIFO)) {
+        error = "RLIMIT_RTPRIO is 0";
+        return false;
+    }
+#endif
+
+    sched_param param{};
+    param.sched_priority = priority;
+    int rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (rc != 0) {
+        error = std::strerror(rc);
+        return false;
+    }
+    return true;
+#endif
+}
+
+bool LockMemory(const void* data, size_t bytes) {
+#ifdef _WIN32
+    return VirtualLock(const_cast<void*>(data), bytes) != 0;
+#else
+    return mlock(data, bytes) == 0;
+#endif
+}
+
+void UnlockMemory(const void* data, size_t bytes) {
+#ifdef _WIN32
+    VirtualUnlock(const_cast<void*>(data), bytes);
+#else
+    munlock(data, bytes);
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Gives the calling thread real-time (SCHED_FIFO) priority where the system
+// allows it. On failure `error` says why and the thread is left unchanged.
+bool PromoteThreadToRealtime(std::string& error);
+
+// Keeps memory resident so touching it never page-faults
+bool LockMemory(const void* data, size_t bytes);
+void UnlockMemory(const void* data, size_t bytes);
\ No newline at end of file
@@ -0,0 +1,377 @@
+#include "SoakTest.h"
+#include "AudioEngine.h"
+#include "BinaryIO.h"
+#include "files.h"
+#include "hash.h"
+#include "Log.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+enum class SoakCommand : uint8_t { Load, Seek, Next, Prev, Pause, Wait, Count };
+constexpr size_t COMMANDS = static_cast<size_t>(SoakCommand::Wait); // the ones that are timed
+const char* const COMMAND_NAMES[] = { "load", "seek", "next", "prev", "pause", "wait" };
+
+struct Step {
+    SoakCommand command = SoakCommand::Wait;
+    double value = 0.0; // track index, seconds or milliseconds
+};
+
+// A command this slow is taken for a deadlock
+constexpr double HANG_SECONDS = 10.0;
+
+using Clock = std::chrono::steady_clock;
+
+// Read by the crash handler and the hang watchdog, so kept in plain buffers
+char g_reportPath[4096];
+char g_lastCommand[128];
+std::atomic<int64_t> g_commandStart{0}; // steady clock ticks, 0 between commands
+
+// Only async-signal-safe calls; the process is going down
+void WriteAbortReport(const char* status, int signal) {
+    char note[512];
+    size_t len = 0;
+    auto append = [&](const char* text) {
+        size_t n = std::min(std::strlen(text), sizeof(note) - 1 - len);
+        std::memcpy(note + len, text, n);
+        len += n;
+    };
+    char digits[12];
+    size_t d = sizeof(digits) - 1;
+    digits[d] = '\0';
+    unsigned value = static_cast<unsigned>(signal);
+    do { digits[--d] = static_cast<char>('0' + value % 10); value /= 10; } while (value && d > 0);
+
+    append("{\"status\": \"");
+    append(status);
+    append("\", \"signal\": ");
+    append(digits + d);
+    append(", \"lastCommand\": \"");
+    append(g_lastCommand);
+    append("\"}\n");
+
+#ifdef _WIN32
+    int fd = _open(g_reportPath, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, 0644);
+    if (fd >= 0) { _write(fd, note, static_cast<unsigned>(len)); _close(fd); }
+    _write(2, note, static_cast<unsigned>(len));
+#else
+    int fd = open(g_reportPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) { (void)!write(fd, note, len); close(fd); }
+    (void)!write(2, note, len);
+#endif
+}
+
+extern "C" void OnSoakCrash(int signal) {
+    WriteAbortReport("crashed", signal);
+    std::signal(signal, SIG_DFL);
+    std::raise(signal);
+}
+
+void WatchForHangs(const std::atomic<bool>& running) {
+    const auto limit = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(HANG_SECONDS));
+    while (running.load()) {
+        int64_t start = g_commandStart.load();
+        if (start != 0 && Clock::now().time_since_epoch().count() - start > limit.count()) {
+            LOG_ERROR("Soak: no return from " << g_lastCommand << " after " << HANG_SECONDS << " s");
+            FlushLog();
+            WriteAbortReport("hung", 0);
+            std::_Exit(2);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+}
+
+void AppendLE(std::string& out, uint32_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+}
+
+bool WriteTone(const fs::path& path, int rate, int channels, double seconds, double hz) {
+    const uint32_t frames = static_cast<uint32_t>(seconds * rate);
+    const uint32_t dataBytes = frames * channels * 2;
+
+    std::string wav;
+    wav.reserve(44 + dataBytes);
+    wav += "RIFF";
+    AppendLE(wav, 36 + dataBytes, 4);
+    wav += "WAVEfmt ";
+    AppendLE(wav, 16, 4);
+    AppendLE(wav, 1, 2); // PCM
+    AppendLE(wav, channels, 2);
+    AppendLE(wav, rate, 4);
+    AppendLE(wav, rate * channels * 2, 4);
+    AppendLE(wav, channels * 2, 2);
+    AppendLE(wav, 16, 2);
+    wav += "data";
+    AppendLE(wav, dataBytes, 4);
+
+    const double step = 2.0 * 3.14159265358979323846 * hz / rate;
+    for (uint32_t i = 0; i < frames; ++i) {
+        auto sample = static_cast<int16_t>(std::lround(std::sin(step * i) * 8000.0));
+        for (int c = 0; c < channels; ++c) AppendLE(wav, static_cast<uint16_t>(sample), 2);
+    }
+    return WriteFileAtomically(path.u8string(), wav, "soak track");
+}
+
+// Alternates 44.1 kHz stereo and 22.05 kHz mono so both resampler paths run;
+// 3 to 12 seconds long so tracks end during the run. Kept in the cache between runs.
+std::unordered_map<std::string, AudioMetadata> SyntheticLibrary(size_t count, std::vector<std::string>& paths) {
+    fs::path dir = fs::u8path(GetCacheDirectory()) / "soak";
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+
+    std::unordered_map<std::string, AudioMetadata> tracks;
+    for (size_t i = 0; i < count; ++i) {
+        const bool stereo = i % 2 == 0;
+        const int rate = stereo ? 44100 : 22050;
+        const double seconds = 3.0 + static_cast<double>(HashMix(i) % 10);
+        fs::path file = dir / ("tone-" + std::to_string(i) + ".wav");
+        const uintmax_t expected = 44 + static_cast<uintmax_t>(seconds * rate) * (stereo ? 4 : 2);
+        if (fs::file_size(file, ec) != expected && !WriteTone(file, rate, stereo ? 2 : 1, seconds, 220.0 + 20.0 * i))
+            continue;
+
+        AudioMetadata meta{};
+        meta.title = "Tone " + std::to_string(i);
+        meta.artist = "Soak";
+        meta.album = "Soak " + std::to_string(i / 12);
+        meta.year = 2000;
+        meta.track = static_cast<int>(i % 12) + 1;
+        meta.duration = seconds;
+        paths.push_back(file.u8string());
+        tracks.emplace(paths.back(), std::move(meta));
+    }
+    return tracks;
+}
+
+bool LoadScript(const std::string& path, std::vector<Step>& steps) {
+    std::ifstream in(fs::u8path(path));
+    if (!in) {
+        LOG_ERROR("Soak: could not read script " << path);
+        return false;
+    }
+    std::string line;
+    for (int number = 1; std::getline(in, line); ++number) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        std::string name;
+        if (!(words >> name)) continue;
+
+        auto it = std::find_if(std::begin(COMMAND_NAMES), std::end(COMMAND_NAMES),
+                               [&](const char* command) { return name == command; });
+        if (it == std::end(COMMAND_NAMES)) {
+            LOG_ERROR("Soak: unknown command '" << name << "' on line " << number << " of " << path);
+            return false;
+        }
+        Step step;
+        step.command = static_cast<SoakCommand>(it - std::begin(COMMAND_NAMES));
+        words >> step.value;
+        steps.push_back(step);
+    }
+    if (steps.empty()) LOG_ERROR("Soak: no commands in " << path);
+    return !steps.empty();
+}
+
+// Weighted towards what users repeat fastest: seeking and skipping
+Step RandomStep(uint64_t& rng, size_t tracks, double duration) {
+    uint64_t r = HashMix(++rng);
+    Step step;
+    switch (r % 20) {
+    case 0: case 1: case 2: case 3: case 4:
+        step.command = SoakCommand::Load;
+        step.value = static_cast<double>((r >> 8) % tracks);
+        break;
+    case 5: case 6: case 7: case 8: case 9: case 10:
+        step.command = SoakCommand::Seek;
+        step.value = duration * static_cast<double>((r >> 8) % 1000) / 1000.0;
+        break;
+    case 11: case 12: case 13:
+        step.command = SoakCommand::Next;
+        break;
+    case 14: case 15:
+        step.command = SoakCommand::Prev;
+        break;
+    default:
+        step.command = SoakCommand::Pause;
+        break;
+    }
+    return step;
+}
+
+// False if the engine did not end up where the command should have left it
+bool Execute(AudioEngine& engine, const Step& step, const std::vector<std::string>& paths) {
+    switch (step.command) {
+    case SoakCommand::Load: {
+        const std::string& path = paths[static_cast<size_t>(step.value) % paths.size()];
+        // Not checked against the snapshot: the worker may already have moved on
+        return engine.loadAndPlay(path);
+    }
+    case SoakCommand::Seek:
+        engine.seek(step.value);
+        return true;
+    case SoakCommand::Next:
+        engine.playNext();
+        return !engine.playbackState()->currentFile.empty();
+    case SoakCommand::Prev:
+        engine.playPrev();
+        return !engine.playbackState()->currentFile.empty();
+    case SoakCommand::Pause:
+        engine.playPause();
+        return true;
+    default:
+        return true;
+    }
+}
+
+struct LatencySummary {
+    double p50 = 0.0, p99 = 0.0, max = 0.0;
+    nlohmann::json histogram = nlohmann::json::array(); // power-of-two buckets, in ms
+};
+
+LatencySummary Summarize(std::vector<double> samples) {
+    LatencySummary summary;
+    if (samples.empty()) return summary;
+    std::sort(samples.begin(), samples.end());
+    auto rank = [&](double q) {
+        size_t i = static_cast<size_t>(std::ceil(q * samples.size()));
+        return samples[std::min(samples.size(), std::max<size_t>(i, 1)) - 1];
+    };
+    summary.p50 = rank(0.50);
+    summary.p99 = rank(0.99);
+    summary.max = samples.back();
+
+    double bound = 0.125;
+    size_t counted = 0;
+    while (counted < samples.size()) {
+        size_t below = static_cast<size_t>(std::lower_bound(samples.begin(), samples.end(), bound) - samples.begin());
+        if (below > counted) summary.histogram.push_back({ {"belowMs", bound}, {"count", below - counted} });
+        counted = below;
+        bound *= 2.0;
+    }
+    return summary;
+}
+
+}
+
+int RunSoakTest(AudioEngine& engine, const SoakOptions& options) {
+    std::vector<std::string> paths;
+    engine.AddTracks(SyntheticLibrary(std::max<size_t>(options.tracks, 1), paths));
+    if (paths.empty()) {
+        LOG_ERROR("Soak: could not write the synthetic library");
+        return 1;
+    }
+
+    std::vector<Step> script;
+    if (!options.script.empty() && !LoadScript(options.script, script)) return 1;
+
+    std::string reportPath = options.reportPath.empty()
+        ? (fs::u8path(GetDataDirectory()) / "soak-report.json").u8string() : options.reportPath;
+    std::snprintf(g_reportPath, sizeof(g_reportPath), "%s", reportPath.c_str());
+    std::snprintf(g_lastCommand, sizeof(g_lastCommand), "none");
+    for (int signal : { SIGSEGV, SIGABRT, SIGFPE, SIGILL }) std::signal(signal, OnSoakCrash);
+
+    std::atomic<bool> running{true};
+    std::thread watchdog(WatchForHangs, std::cref(running));
+
+    const AudioEngine::DeadlineStats before = engine.deadlineStats();
+    std::vector<double> latencies[COMMANDS];
+    uint64_t executed = 0, failures = 0;
+    uint64_t rng = options.seed;
+    size_t scriptPos = 0;
+
+    const auto start = Clock::now();
+    auto elapsed = [&] { return std::chrono::duration<double>(Clock::now() - start).count(); };
+    while (elapsed() < options.seconds) {
+        Step step = script.empty() ? RandomStep(rng, paths.size(), engine.duration())
+                                   : script[scriptPos++ % script.size()];
+        if (step.command == SoakCommand::Wait) {
+            std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(step.value));
+            continue;
+        }
+
+        std::snprintf(g_lastCommand, sizeof(g_lastCommand), "#%llu %s %.2f",
+                      static_cast<unsigned long long>(executed), COMMAND_NAMES[static_cast<size_t>(step.command)], step.value);
+        auto t0 = Clock::now();
+        g_commandStart.store(t0.time_since_epoch().count());
+        bool ok = Execute(engine, step, paths);
+        g_commandStart.store(0);
+        latencies[static_cast<size_t>(step.command)].push_back(
+            std::chrono::duration<double, std::milli>(Clock::now() - t0).count());
+
+        executed++;
+        if (!ok) {
+            failures++;
+            LOG_WARNING("Soak: " << g_lastCommand << " left the engine in the wrong state");
+        }
+
+        // A third of the commands follow the last one at once, like key repeat
+        if (script.empty()) {
+            uint64_t r = HashMix(++rng);
+            if (r % 3 != 0) std::this_thread::sleep_for(std::chrono::milliseconds((r >> 8) % 300));
+        }
+    }
+    const double seconds = elapsed();
+    engine.pause();
+
+    running = false;
+    watchdog.join();
+    for (int signal : { SIGSEGV, SIGABRT, SIGFPE, SIGILL }) std::signal(signal, SIG_DFL);
+
+    const AudioEngine::DeadlineStats after = engine.deadlineStats();
+    const AudioEngine::TrackStartStats starts = engine.trackStartStats();
+    nlohmann::json commands = nlohmann::json::object();
+    std::ostringstream text;
+    text << "Soak: " << executed << " commands in " << seconds << " s, " << failures << " failed, "
+         << after.underruns - before.underruns << " underruns\n";
+    for (size_t i = 0; i < COMMANDS; ++i) {
+        LatencySummary summary = Summarize(latencies[i]);
+        commands[COMMAND_NAMES[i]] = {
+            {"count", latencies[i].size()},
+            {"p50Ms", summary.p50},
+            {"p99Ms", summary.p99},
+            {"maxMs", summary.max},
+            {"histogram", summary.histogram},
+        };
+        text << "  " << COMMAND_NAMES[i] << ": " << latencies[i].size() << " x, p50 " << summary.p50
+             << " ms, p99 " << summary.p99 << " ms, max " << summary.max << " ms\n";
+    }
+
+    nlohmann::json report = {
+        {"status", failures == 0 ? "ok" : "failed"},
+        {"seconds", seconds},
+        {"seed", options.seed},
+        {"script", options.script},
+        {"tracks", paths.size()},
+        {"realtime", engine.realtime()},
+        {"commands", executed},
+        {"failures", failures},
+        {"underruns", after.underruns - before.underruns},
+        {"nearMisses", after.nearMisses - before.nearMisses},
+        {"timeToFirstAudio", { {"meanMs", starts.meanMs}, {"worstMs", starts.worstMs} }},
+        {"latency", commands},
+    };
+    WriteFileAtomically(reportPath, report.dump(2) + "\n", "soak report");
+
+    std::cout << text.str() << "Report: " << reportPath << "\n";
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class AudioEngine;
+
+// Drives the engine with load, seek, next, prev and pause commands the way
+// someone hammering the controls would, and reports how long each kind took.
+// The library is generated: short WAV tones, so tracks also end and advance
+// on their own while commands keep coming.
+struct SoakOptions {
+    double seconds = 60.0;
+    size_t tracks = 24;
+    uint64_t seed = 1;
+    std::string script;     // commands to repeat instead of random ones
+    std::string reportPath; // defaults to soak-report.json in the data directory
+};
+
+// Script lines: "load <index>", "seek <seconds>", "next", "prev", "pause",
+// "wait <ms>"; '#' starts a comment. Returns the exit code, non-zero if a
+// command failed. A hang or crash writes a short report and ends the process.
+int RunSoakTest(AudioEngine& engine, const SoakOptions& options);
\ No newline at end of file
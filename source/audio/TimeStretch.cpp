@@ -0,0 +1,258 @@
+#include "TimeStretch.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define VESPER_HAS_SSE2 1
+#endif
+
+namespace {
+
+constexpr double PI = 3.14159265358979323846;
+constexpr float SCALE = 1.0f / 32768.0f;
+constexpr size_t COARSE_STEP = 4; // search every 4th offset, then refine around the best
+
+// Sum of a[i] * b[i], and of b[i] * b[i] for normalising
+float Correlate(const float* a, const float* b, size_t n, float& energy) {
+    size_t i = 0;
+    float dot = 0.0f, sum = 0.0f;
+#ifdef VESPER_HAS_SSE2
+    __m128 vdot = _mm_setzero_ps(), vsum = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4) {
+        __m128 va = _mm_loadu_ps(a + i);
+        __m128 vb = _mm_loadu_ps(b + i);
+        vdot = _mm_add_ps(vdot, _mm_mul_ps(va, vb));
+        vsum = _mm_add_ps(vsum, _mm_mul_ps(vb, vb));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, vdot);
+    dot = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm_storeu_ps(lanes, vsum);
+    sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for (; i < n; ++i) {
+        dot += a[i] * b[i];
+        sum += b[i] * b[i];
+    }
+    energy = sum;
+    return dot;
+}
+
+// out[i] = overlap[i] + window[i] * in[i] over interleaved stereo; window is per frame
+void OverlapAdd(float* out, const float* overlap, const float* window, const float* in, size_t frames) {
+    size_t i = 0;
+#ifdef VESPER_HAS_SSE2
+    for (; i + 2 <= frames; i += 2) {
+        __m128 w = _mm_set_ps(window[i + 1], window[i + 1], window[i], window[i]);
+        __m128 v = _mm_add_ps(_mm_loadu_ps(overlap + i * 2), _mm_mul_ps(w, _mm_loadu_ps(in + i * 2)));
+        _mm_storeu_ps(out + i * 2, v);
+    }
+#endif
+    for (; i < frames; ++i) {
+        out[i * 2] = overlap[i * 2] + window[i] * in[i * 2];
+        out[i * 2 + 1] = overlap[i * 2 + 1] + window[i] * in[i * 2 + 1];
+    }
+}
+
+int16_t ToSample(float value) {
+    return static_cast<int16_t>(std::clamp(std::lrint(value * 32768.0f), -32768L, 32767L));
+}
+
+} // namespace
+
+void TimeStretch::configure(int sampleRate) {
+    // About 23 ms segments at 44.1 kHz: long enough for bass, short enough not to smear
+    size_t window = 256;
+    while (window * 1000 < size_t(std::max(sampleRate, 8000)) * 20) window *= 2;
+    m_window = window;
+    m_hop = window / 2;
+    m_tolerance = window / 4;
+
+    // Periodic Hann: two windows half a window apart add up to exactly one
+    m_hann.resize(m_window);
+    for (size_t i = 0; i < m_window; ++i)
+        m_hann[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * PI * double(i) / double(m_window)));
+    m_overlap.assign(m_hop * 2, 0.0f);
+    m_mixed.assign(m_hop * 2, 0.0f);
+    reset();
+}
+
+void TimeStretch::reset() {
+    m_input.clear();
+    m_mono.clear();
+    m_output.clear();
+    m_hops.clear();
+    m_outputRead = 0;
+    m_dropped = 0.0;
+    m_analysis = 0.0;
+    m_previous = 0;
+    m_started = false;
+    m_flushed = false;
+    m_sourceEnd = -1.0;
+}
+
+void TimeStretch::setSpeed(float speed) {
+    m_speed = std::clamp(speed, MIN_SPEED, MAX_SPEED);
+}
+
+void TimeStretch::push(const int16_t* frames, size_t count) {
+    if (m_window == 0 || m_flushed) return;
+    size_t base = m_mono.size();
+    m_input.resize((base + count) * 2);
+    m_mono.resize(base + count);
+    for (size_t i = 0; i < count; ++i) {
+        float left = frames[i * 2] * SCALE, right = frames[i * 2 + 1] * SCALE;
+        m_input[(base + i) * 2] = left;
+        m_input[(base + i) * 2 + 1] = right;
+        m_mono[base + i] = left + right;
+    }
+    while (makeHop()) {}
+}
+
+void TimeStretch::flush() {
+    if (m_window == 0 || m_flushed) return;
+    m_sourceEnd = m_dropped + double(m_mono.size());
+    // Silence behind the end gives the search room; hops that start past the end are cut below
+    std::vector<int16_t> silence((m_window + m_tolerance * 2 + m_hop) * 2, 0);
+    push(silence.data(), silence.size() / 2);
+    m_flushed = true;
+
+    while (!m_hops.empty() && m_hops.back().source >= m_sourceEnd) {
+        m_hops.pop_back();
+        m_output.resize(m_output.size() - m_hop * 2);
+    }
+}
+
+// Start of the segment in m_input that best continues the natural one
+size_t TimeStretch::findSegment(size_t natural, size_t target) const {
+    size_t low = target > m_tolerance ? target - m_tolerance : 0;
+    size_t high = target + m_tolerance;
+    const float* reference = m_mono.data() + natural;
+
+    float bestScore = -1e30f;
+    size_t best = target;
+    auto consider = [&](size_t start) {
+        float energy;
+        float dot = Correlate(reference, m_mono.data() + start, m_hop, energy);
+        float score = dot / std::sqrt(energy + 1e-9f);
+        if (score > bestScore) {
+            bestScore = score;
+            best = start;
+        }
+    };
+
+    for (size_t start = low; start <= high; start += COARSE_STEP) consider(start);
+    size_t coarse = best;
+    size_t from = coarse > low + COARSE_STEP ? coarse - COARSE_STEP + 1 : low;
+    size_t to = std::min(high, coarse + COARSE_STEP - 1);
+    for (size_t start = from; start <= to; ++start) {
+        if (start != coarse) consider(start);
+    }
+    return best;
+}
+
+// One hop of output if enough input is buffered
+bool TimeStretch::makeHop() {
+    size_t target = static_cast<size_t>(std::lround(m_analysis));
+    size_t natural = m_previous + m_hop;
+    size_t needed = std::max(target + m_tolerance + m_window, natural + m_hop);
+    if (m_mono.size() < needed) return false;
+
+    size_t start;
+    if (!m_started) {
+        // As if the same audio had been playing before, so the first hop is not faded in
+        start = target;
+        for (size_t i = 0; i < m_hop; ++i) {
+            m_overlap[i * 2] = m_hann[m_hop + i] * m_input[(start + i) * 2];
+            m_overlap[i * 2 + 1] = m_hann[m_hop + i] * m_input[(start + i) * 2 + 1];
+        }
+        m_started = true;
+    }
+    else if (m_speed == 1.0f) {
+        // Plain continuation: at normal speed the input comes out unchanged
+        start = natural;
+        m_analysis = double(natural);
+    }
+    else {
+        start = findSegment(natural, target);
+    }
+
+    size_t out = m_output.size();
+    m_output.resize(out + m_hop * 2);
+    const float* segment = m_input.data() + start * 2;
+    OverlapAdd(m_mixed.data(), m_overlap.data(), m_hann.data(), segment, m_hop);
+    for (size_t i = 0; i < m_hop * 2; ++i) m_output[out + i] = ToSample(m_mixed[i]);
+
+    // The second half waits for the next segment
+    const float* tail = segment + m_hop * 2;
+    for (size_t i = 0; i < m_hop; ++i) {
+        m_overlap[i * 2] = m_hann[m_hop + i] * tail[i * 2];
+        m_overlap[i * 2 + 1] = m_hann[m_hop + i] * tail[i * 2 + 1];
+    }
+
+    m_hops.push_back({ m_dropped + double(start), m_speed });
+    m_previous = start;
+    m_analysis += double(m_hop) * m_speed;
+    discardInput();
+    return true;
+}
+
+// Input before anything a later hop can still read is dropped now and then
+void TimeStretch::discardInput() {
+    size_t keep = std::min(m_previous + m_hop, static_cast<size_t>(std::max(0.0, m_analysis - double(m_tolerance))));
+    if (keep < m_window * 8) return;
+    m_input.erase(m_input.begin(), m_input.begin() + keep * 2);
+    m_mono.erase(m_mono.begin(), m_mono.begin() + keep);
+    m_dropped += double(keep);
+    m_previous -= keep;
+    m_analysis -= double(keep);
+}
+
+size_t TimeStretch::pop(int16_t* frames, size_t count) {
+    count = std::min(count, available());
+    std::copy_n(m_output.data() + m_outputRead * 2, count * 2, frames);
+    m_outputRead += count;
+    while (!m_hops.empty() && m_outputRead >= m_hop) {
+        m_hops.pop_front();
+        m_outputRead -= m_hop;
+        m_output.erase(m_output.begin(), m_output.begin() + m_hop * 2);
+    }
+    return count;
+}
+
+double TimeStretch::sourcePosition() const {
+    if (m_hops.empty()) return m_sourceEnd >= 0.0 ? m_sourceEnd : m_dropped + m_analysis;
+    const Hop& hop = m_hops.front();
+    return hop.source + double(m_outputRead) * hop.speed;
+}
+
+void StretchClock::reset(double sourceFrame) {
+    m_base = { 0.0, sourceFrame };
+    m_first = 0;
+    m_count = 0;
+}
+
+void StretchClock::mark(double outputFrames, double sourceFrame) {
+    if (m_count == CAPACITY) { // should not happen with the device queue this short
+        m_base = m_marks[m_first];
+        m_first = (m_first + 1) % CAPACITY;
+        --m_count;
+    }
+    m_marks[(m_first + m_count) % CAPACITY] = { outputFrames, sourceFrame };
+    ++m_count;
+}
+
+double StretchClock::sourceAt(double outputFrame) {
+    while (m_count > 0 && m_marks[m_first].output <= outputFrame) {
+        m_base = m_marks[m_first];
+        m_first = (m_first + 1) % CAPACITY;
+        --m_count;
+    }
+    if (m_count == 0) return m_base.source + (outputFrame - m_base.output);
+
+    const Mark& next = m_marks[m_first];
+    double span = next.output - m_base.output;
+    double t = span > 0.0 ? (outputFrame - m_base.output) / span : 0.0;
+    return m_base.source + t * (next.source - m_base.source);
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+// Tempo change without pitch change for interleaved 16-bit stereo (WSOLA).
+// Hann-windowed segments are overlap-added at a fixed output hop; the input
+// advances by hop * speed, and each segment is moved within a small window
+// to where it best continues the previous one, so waveforms line up and no
+// phase jumps are heard. Not thread-safe; the engine uses it under its track mutex.
+class TimeStretch {
+public:
+    static constexpr float MIN_SPEED = 0.5f;
+    static constexpr float MAX_SPEED = 2.0f;
+
+    // Sizes the window for the sample rate and drops all state
+    void configure(int sampleRate);
+    // Drops buffered audio, e.g. after a seek
+    void reset();
+    // Takes effect from the next hop, a few milliseconds of output
+    void setSpeed(float speed);
+
+    void push(const int16_t* frames, size_t count);
+    // End of the source: lets the last pushed frames come out
+    void flush();
+
+    size_t available() const { return m_output.size() / 2 - m_outputRead; }
+    size_t pop(int16_t* frames, size_t count);
+    // Source frame, counted since the last reset, of the next frame pop() returns
+    double sourcePosition() const;
+
+private:
+    struct Hop {
+        double source; // source frame of the hop's first output frame
+        float speed;
+    };
+
+    bool makeHop();
+    size_t findSegment(size_t natural, size_t target) const;
+    void discardInput();
+
+    size_t m_window = 0;    // frames per segment
+    size_t m_hop = 0;       // output frames per hop, half a window
+    size_t m_tolerance = 0; // how far a segment may move, either way
+    std::vector<float> m_hann;
+
+    std::vector<float> m_input; // interleaved stereo, scaled to [-1, 1)
+    std::vector<float> m_mono;  // the same frames mixed down, for the search
+    double m_dropped = 0.0;     // source frames already removed from m_input
+    double m_analysis = 0.0;    // ideal start of the next segment in m_input
+    size_t m_previous = 0;      // start of the previous segment in m_input
+    bool m_started = false;
+    bool m_flushed = false;
+    double m_sourceEnd = -1.0;  // source frames pushed before flush()
+
+    std::vector<float> m_overlap; // second half of the previous windowed segment
+    std::vector<float> m_mixed;
+    std::vector<int16_t> m_output;
+    size_t m_outputRead = 0;      // frames
+    std::deque<Hop> m_hops;       // one per hop still in m_output
+    float m_speed = 1.0f;
+};
+
+// Which source frame is heard while the device plays a given output frame.
+// Marks are set as blocks leave the stretcher; fixed storage, no allocation.
+class StretchClock {
+public:
+    void reset(double sourceFrame);
+    // Output frames produced so far, and the source frame the next one starts at
+    void mark(double outputFrames, double sourceFrame);
+    // Forgets marks before `outputFrame`
+    double sourceAt(double outputFrame);
+
+private:
+    struct Mark {
+        double output;
+        double source;
+    };
+    static constexpr size_t CAPACITY = 64;
+
+    Mark m_base{ 0.0, 0.0 };
+    Mark m_marks[CAPACITY];
+    size_t m_first = 0;
+    size_t m_count = 0;
+};
\ No newline at end of file
@@ -0,0 +1,356 @@
+#include "Headless.h"
+#include "AudioEngine.h"
+#include "JobSystem.h"
+#include "Log.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+#ifdef _WIN32
+#include <conio.h>
+#else
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct HeadlessArgs {
+    std::string command;
+    std::vector<std::string> positional;
+    bool json = false;
+    bool shuffle = false;
+    std::string artist;
+    std::string album;
+    SortColumn sort = SortColumn::Added;
+};
+
+std::string Lower(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+    return text;
+}
+
+bool Contains(const std::string& haystack, const std::string& lowerNeedle) {
+    return lowerNeedle.empty() || Lower(haystack).find(lowerNeedle) != std::string::npos;
+}
+
+// Options the GUI build also takes (--log-level, --realtime, ...) were handled by main
+bool ParseArgs(int argc, char** argv, int first, HeadlessArgs& args) {
+    args.command = argv[first];
+    for (int i = first + 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--json") args.json = true;
+        else if (arg == "--shuffle") args.shuffle = true;
+        else if (arg.rfind("--artist=", 0) == 0) args.artist = Lower(arg.substr(9));
+        else if (arg.rfind("--album=", 0) == 0) args.album = Lower(arg.substr(8));
+        else if (arg.rfind("--sort=", 0) == 0) {
+            std::string name = Lower(arg.substr(7));
+            int column = 0;
+            while (column < static_cast<int>(SortColumn::Count) && Lower(SortColumnName(static_cast<SortColumn>(column))) != name)
+                ++column;
+            if (column == static_cast<int>(SortColumn::Count)) {
+                LOG_ERROR("Unknown sort column: " << name);
+                return false;
+            }
+            args.sort = static_cast<SortColumn>(column);
+        }
+        else if (arg.rfind("--", 0) != 0) args.positional.push_back(arg);
+    }
+    return true;
+}
+
+std::string FormatTime(double seconds) {
+    int total = std::max(0, static_cast<int>(seconds));
+    char text[16];
+    std::snprintf(text, sizeof(text), "%d:%02d", total / 60, total % 60);
+    return text;
+}
+
+nlohmann::json TrackJson(const Library& library, TrackId id) {
+    const AudioMetadata& meta = library.metadata(id);
+    return {
+        {"id", id},
+        {"path", library.path(id)},
+        {"title", meta.title},
+        {"artist", meta.artist},
+        {"album", meta.album},
+        {"album_artist", meta.albumArtist.empty() ? meta.artist : meta.albumArtist},
+        {"year", meta.year},
+        {"track", meta.track},
+        {"date", meta.date_str},
+        {"duration", meta.duration},
+    };
+}
+
+// JSON array, or one tab-separated line per track: length, name, path
+void PrintTracks(const Library& library, const std::vector<TrackId>& ids, bool json) {
+    if (json) {
+        nlohmann::json tracks = nlohmann::json::array();
+        for (TrackId id : ids) tracks.push_back(TrackJson(library, id));
+        std::cout << tracks.dump(2) << "\n";
+        return;
+    }
+    for (TrackId id : ids)
+        std::cout << FormatTime(library.metadata(id).duration) << "\t" << library.displayName(id) << "\t" << library.path(id) << "\n";
+}
+
+int Scan(AudioEngine& engine, const HeadlessArgs& args) {
+    if (args.positional.empty()) {
+        LOG_ERROR("scan: no folders given");
+        return 2;
+    }
+    engine.LoadLibraryDatabase();
+    // One worker never takes background work; the rest all read tags
+    engine.setTagJobs(std::max(1u, GetJobSystem().workerCount() - 1));
+
+    auto start = std::chrono::steady_clock::now();
+    size_t before = engine.GetLibrary()->size();
+    std::vector<std::string> files;
+    int exitCode = 0;
+    for (const std::string& arg : args.positional) {
+        std::error_code ec;
+        if (!fs::is_directory(fs::u8path(arg), ec)) {
+            LOG_ERROR("scan: not a folder: " << arg);
+            exitCode = 1;
+            continue;
+        }
+        // Stored as the GUI's folder picker would give them
+        std::string folder = fs::absolute(fs::u8path(arg), ec).u8string();
+        std::vector<std::string> listed = ListAudioFiles(folder);
+        files.insert(files.end(), listed.begin(), listed.end());
+        engine.AddFiles(std::move(listed));
+    }
+    while (!engine.waitForTags(std::chrono::seconds(2)))
+        LOG_INFO("scan: " << engine.pendingTags() << " files left");
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    auto library = engine.GetLibrary();
+    std::vector<TrackId> ids;
+    for (const std::string& file : files) {
+        TrackId id = library->find(file);
+        if (id != INVALID_TRACK) ids.push_back(id);
+    }
+    if (args.json) PrintTracks(*library, ids, true);
+    else std::cout << "Scanned " << ids.size() << " files (" << library->size() - before << " new) in "
+                   << seconds << " s; the library has " << library->size() << " tracks\n";
+    return exitCode;
+}
+
+int Query(AudioEngine& engine, const HeadlessArgs& args) {
+    if (!engine.LoadLibraryDatabase()) {
+        LOG_ERROR("query: no library yet; add folders with 'scan'");
+        return 1;
+    }
+    std::string text;
+    for (const std::string& word : args.positional) text += (text.empty() ? "" : " ") + word;
+    text = Lower(text);
+
+    auto library = engine.GetLibrary();
+    std::vector<TrackId> ids;
+    for (TrackId id : library->order(args.sort)) {
+        const AudioMetadata& meta = library->metadata(id);
+        if (!Contains(meta.artist, args.artist) || !Contains(meta.album, args.album)) continue;
+        if (!text.empty() && !Contains(meta.title, text) && !Contains(meta.artist, text) &&
+            !Contains(meta.album, text) && !Contains(library->path(id), text)) continue;
+        ids.push_back(id);
+    }
+    PrintTracks(*library, ids, args.json);
+    return 0;
+}
+
+enum Key : int { KEY_UP = 0x100, KEY_DOWN, KEY_LEFT, KEY_RIGHT };
+
+// Single unechoed key presses; the terminal is put back on destruction.
+// Without a terminal (piped input) it only waits.
+class TerminalKeys {
+public:
+    TerminalKeys() {
+#ifndef _WIN32
+        m_tty = isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &m_saved) == 0;
+        if (!m_tty) return;
+        termios raw = m_saved;
+        raw.c_lflag &= ~(ICANON | ECHO); // Ctrl+C still interrupts
+        raw.c_cc[VMIN] = 0;
+        raw.c_cc[VTIME] = 0;
+        tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+#endif
+    }
+    ~TerminalKeys() {
+#ifndef _WIN32
+        if (m_tty) tcsetattr(STDIN_FILENO, TCSANOW, &m_saved);
+#endif
+    }
+
+    TerminalKeys(const TerminalKeys&) = delete;
+    TerminalKeys& operator=(const TerminalKeys&) = delete;
+
+    // A key, or 0 if none came within the timeout
+    int read(int timeoutMs) {
+#ifdef _WIN32
+        for (int waited = 0; !_kbhit(); waited += 10) {
+            if (waited >= timeoutMs) return 0;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        int key = _getch();
+        if (key != 0 && key != 224) return key;
+        switch (_getch()) {
+        case 72: return KEY_UP;
+        case 80: return KEY_DOWN;
+        case 75: return KEY_LEFT;
+        case 77: return KEY_RIGHT;
+        default: return 0;
+        }
+#else
+        if (!m_tty) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+            return 0;
+        }
+        int key = readByte(timeoutMs);
+        if (key != 0x1b) return key;
+        // Arrow keys arrive as ESC [ A..D
+        if (readByte(20) != '[') return 0x1b;
+        switch (readByte(20)) {
+        case 'A': return KEY_UP;
+        case 'B': return KEY_DOWN;
+        case 'C': return KEY_RIGHT;
+        case 'D': return KEY_LEFT;
+        default: return 0;
+        }
+#endif
+    }
+
+private:
+#ifndef _WIN32
+    int readByte(int timeoutMs) {
+        pollfd fd{ STDIN_FILENO, POLLIN, 0 };
+        unsigned char c = 0;
+        if (poll(&fd, 1, timeoutMs) <= 0 || ::read(STDIN_FILENO, &c, 1) != 1) return 0;
+        return c;
+    }
+
+    bool m_tty = false;
+    termios m_saved{};
+#endif
+};
+
+std::atomic<bool> g_interrupted{false};
+
+extern "C" void OnInterrupt(int) {
+    g_interrupted = true;
+}
+
+int Play(AudioEngine& engine, const HeadlessArgs& args) {
+    if (args.positional.empty()) {
+        LOG_ERROR("play: no files, folders or playlist given");
+        return 2;
+    }
+    engine.init();
+    engine.LoadLibraryDatabase();
+
+    // Files and folders make a queue; a single other name is a saved playlist
+    std::vector<std::string> queue;
+    for (const std::string& arg : args.positional) {
+        std::error_code ec;
+        fs::path path = fs::u8path(arg);
+        if (fs::is_directory(path, ec)) {
+            std::vector<std::string> listed = ListAudioFiles(fs::absolute(path, ec).u8string());
+            queue.insert(queue.end(), listed.begin(), listed.end());
+        }
+        else if (fs::is_regular_file(path, ec)) {
+            queue.push_back(fs::absolute(path, ec).u8string());
+        }
+        else if (args.positional.size() > 1 || !engine.LoadPlaylist(arg)) {
+            LOG_ERROR("play: no such file, folder or playlist: " << arg);
+            return 1;
+        }
+    }
+    if (!queue.empty()) engine.SetQueue("Command line", queue);
+    engine.setShuffle(args.shuffle);
+    engine.playNext(); // nothing is current yet, so this is the first entry
+
+    std::cout << "Space pause, n/p next/prev, left/right seek, up/down volume, s shuffle, r repeat, q quit\n";
+    TerminalKeys keys;
+    g_interrupted = false;
+    auto previousHandler = std::signal(SIGINT, OnInterrupt);
+
+    size_t lastWidth = 0;
+    bool paused = false;
+    uint64_t idleVersion = 0;
+    int idlePolls = 0;
+    while (!g_interrupted) {
+        int key = keys.read(250);
+        if (key == 'q' || key == 'Q') break;
+        switch (key) {
+        case ' ': engine.playPause(); paused = !paused; break;
+        case 'n': engine.playNext(); paused = false; break;
+        case 'p': engine.playPrev(); paused = false; break;
+        case KEY_LEFT: engine.seek(engine.position() - 10.0); paused = false; break;
+        case KEY_RIGHT: engine.seek(engine.position() + 10.0); paused = false; break;
+        case KEY_UP: engine.setVolume(engine.volume() + 0.05f); break;
+        case KEY_DOWN: engine.setVolume(engine.volume() - 0.05f); break;
+        case 's': engine.setShuffle(!engine.getShuffle()); break;
+        case 'r': engine.setRepeatOne(!engine.getRepeatOne()); break;
+        default: break;
+        }
+
+        // The queue has run out, or a track failed to open; a switch in
+        // progress also looks stopped for a moment, so two polls must agree
+        auto state = engine.playbackState();
+        if (!engine.isPlaying() && !paused) {
+            if (idlePolls > 0 && engine.stateVersion() == idleVersion) {
+                if (state->currentTrack == INVALID_TRACK) break;
+                engine.playNext();
+                idlePolls = 0;
+                continue;
+            }
+            idleVersion = engine.stateVersion();
+            idlePolls++;
+        }
+        else {
+            idlePolls = 0;
+        }
+
+        auto library = engine.GetLibrary();
+        std::string name = state->currentTrack != INVALID_TRACK && state->currentTrack < library->size()
+            ? library->displayName(state->currentTrack) : fs::u8path(state->currentFile).filename().u8string();
+        std::string line = std::string(engine.isPlaying() ? "> " : "|| ") + FormatTime(engine.position()) + " / "
+            + FormatTime(engine.duration()) + "  " + name + "  vol " + std::to_string(std::lround(engine.volume() * 100)) + "%"
+            + (engine.getShuffle() ? "  shuffle" : "") + (engine.getRepeatOne() ? "  repeat" : "");
+        std::cout << "\r" << line << std::string(lastWidth > line.size() ? lastWidth - line.size() : 0, ' ') << std::flush;
+        lastWidth = line.size();
+    }
+    std::cout << "\n";
+
+    std::signal(SIGINT, previousHandler);
+    engine.pause();
+    return 0;
+}
+
+}
+
+bool IsHeadlessCommand(const std::string& arg) {
+    return arg == "scan" || arg == "query" || arg == "play";
+}
+
+int RunHeadless(AudioEngine& engine, int argc, char** argv, int first) {
+    HeadlessArgs args;
+    if (!ParseArgs(argc, argv, first, args)) return 2;
+    try {
+        if (args.command == "scan") return Scan(engine, args);
+        if (args.command == "query") return Query(engine, args);
+        return Play(engine, args);
+    } catch (const std::exception& e) {
+        LOG_ERROR(e.what());
+        return 1;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+
+class AudioEngine;
+
+// Vesper without a window; GLFW, OpenGL and the fonts are never touched.
+//   scan <folder>... [--json]                  adds folders, reading tags on every worker
+//   query [text] [--artist=] [--album=] [--sort=title|artist|album|year|added] [--json]
+//   play <file|folder>... | <playlist> [--shuffle]   keys control playback on the terminal
+bool IsHeadlessCommand(const std::string& arg);
+
+// argv[first] is the command; returns the exit code
+int RunHeadless(AudioEngine& engine, int argc, char** argv, int first);
\ No newline at end of file
@@ -0,0 +1,186 @@
+#include "AllocTracker.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    #include <malloc.h>
+    #define VESPER_HAS_MALLINFO2 1
+#elif defined(__APPLE__)
+    #include <malloc/malloc.h>
+#endif
+
+namespace {
+
+struct Counters {
+    std::atomic<int64_t> live{ 0 };
+    std::atomic<int64_t> peak{ 0 };
+    std::atomic<int64_t> blocks{ 0 };
+    std::atomic<uint64_t> allocations{ 0 };
+    std::atomic<uint64_t> bytes{ 0 };
+};
+
+// Constant-initialised, so usable by allocations made before main
+Counters g_counters[static_cast<size_t>(AllocTag::Count)];
+thread_local AllocTag t_tag = AllocTag::Other;
+
+// In front of every block while tracking, and of every over-aligned block
+struct Header {
+    uint64_t size;
+    uint32_t tag;
+    uint32_t offset; // from the start of the malloc'd block to the user pointer
+};
+constexpr size_t HEADER = 16;
+static_assert(sizeof(Header) <= HEADER, "header must fit");
+
+bool Enabled() {
+    static const bool enabled = [] {
+        const char* value = std::getenv("VESPER_TRACK_ALLOCS");
+        return value && *value && *value != '0';
+    }();
+    return enabled;
+}
+
+void Count(const Header& header, bool allocated) {
+    Counters& c = g_counters[header.tag];
+    int64_t size = static_cast<int64_t>(header.size);
+    if (!allocated) {
+        c.live.fetch_sub(size, std::memory_order_relaxed);
+        c.blocks.fetch_sub(1, std::memory_order_relaxed);
+        return;
+    }
+    int64_t live = c.live.fetch_add(size, std::memory_order_relaxed) + size;
+    c.blocks.fetch_add(1, std::memory_order_relaxed);
+    c.allocations.fetch_add(1, std::memory_order_relaxed);
+    c.bytes.fetch_add(header.size, std::memory_order_relaxed);
+    int64_t peak = c.peak.load(std::memory_order_relaxed);
+    while (live > peak && !c.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+}
+
+// align is 0 for plain new
+void* Allocate(size_t size, size_t align) {
+    if (size == 0) size = 1;
+    bool tracked = Enabled();
+    if (!tracked && align == 0) return std::malloc(size);
+
+    size_t extra = align > alignof(std::max_align_t) ? align : 0;
+    char* raw = static_cast<char*>(std::malloc(size + HEADER + extra));
+    if (!raw) return nullptr;
+    char* user = raw + HEADER;
+    if (extra) user = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(user) + align - 1) & ~uintptr_t(align - 1));
+
+    Header* header = reinterpret_cast<Header*>(user - HEADER);
+    header->size = size;
+    header->tag = static_cast<uint32_t>(t_tag);
+    header->offset = static_cast<uint32_t>(user - raw);
+    if (tracked) Count(*header, true);
+    return user;
+}
+
+void Deallocate(void* ptr, bool aligned) {
+    if (!ptr) return;
+    bool tracked = Enabled();
+    if (!tracked && !aligned) {
+        std::free(ptr);
+        return;
+    }
+    char* user = static_cast<char*>(ptr);
+    const Header* header = reinterpret_cast<const Header*>(user - HEADER);
+    if (tracked) Count(*header, false);
+    std::free(user - header->offset);
+}
+
+void* AllocateOrThrow(size_t size, size_t align) {
+    for (;;) {
+        if (void* ptr = Allocate(size, align)) return ptr;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+} // namespace
+
+const char* AllocTagName(AllocTag tag) {
+    switch (tag) {
+        case AllocTag::Audio:   return "Audio";
+        case AllocTag::Library: return "Library";
+        case AllocTag::Art:     return "Album art";
+        case AllocTag::Lyrics:  return "Lyrics";
+        case AllocTag::Gui:     return "GUI";
+        default:                return "Other";
+    }
+}
+
+bool AllocTrackingEnabled() {
+    return Enabled();
+}
+
+AllocScope::AllocScope(AllocTag tag) : m_previous(t_tag) {
+    t_tag = tag;
+}
+
+AllocScope::~AllocScope() {
+    t_tag = m_previous;
+}
+
+AllocTag CurrentAllocTag() {
+    return t_tag;
+}
+
+AllocStats GetAllocStats(AllocTag tag) {
+    const Counters& c = g_counters[static_cast<size_t>(tag)];
+    AllocStats stats;
+    stats.liveBytes = c.live.load(std::memory_order_relaxed);
+    stats.peakBytes = c.peak.load(std::memory_order_relaxed);
+    stats.liveBlocks = c.blocks.load(std::memory_order_relaxed);
+    stats.allocations = c.allocations.load(std::memory_order_relaxed);
+    stats.totalBytes = c.bytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+int64_t UntrackedHeapBytes() {
+    int64_t inUse = -1;
+#if defined(VESPER_HAS_MALLINFO2)
+    struct mallinfo2 info = mallinfo2();
+    inUse = static_cast<int64_t>(info.uordblks + info.hblkhd);
+#elif defined(__APPLE__)
+    malloc_statistics_t stats;
+    malloc_zone_statistics(nullptr, &stats);
+    inUse = static_cast<int64_t>(stats.size_in_use);
+#endif
+    if (inUse < 0) return -1;
+
+    // Tracked blocks and their headers are in the heap figure too
+    for (size_t i = 0; i < static_cast<size_t>(AllocTag::Count); ++i) {
+        AllocStats stats = GetAllocStats(static_cast<AllocTag>(i));
+        inUse -= stats.liveBytes + stats.liveBlocks * static_cast<int64_t>(HEADER);
+    }
+    return std::max<int64_t>(inUse, 0);
+}
+
+// Replaceable global allocation functions
+
+void* operator new(std::size_t size) { return AllocateOrThrow(size, 0); }
+void* operator new[](std::size_t size) { return AllocateOrThrow(size, 0); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return Allocate(size, 0); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return Allocate(size, 0); }
+void* operator new(std::size_t size, std::align_val_t align) { return AllocateOrThrow(size, static_cast<size_t>(align)); }
+void* operator new[](std::size_t size, std::align_val_t align) { return AllocateOrThrow(size, static_cast<size_t>(align)); }
+void* operator new(std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return Allocate(size, static_cast<size_t>(align)); }
+void* operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return Allocate(size, static_cast<size_t>(align)); }
+
+void operator delete(void* ptr) noexcept { Deallocate(ptr, false); }
+void operator delete[](void* ptr) noexcept { Deallocate(ptr, false); }
+void operator delete(void* ptr, std::size_t) noexcept { Deallocate(ptr, false); }
+void operator delete[](void* ptr, std::size_t) noexcept { Deallocate(ptr, false); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { Deallocate(ptr, false); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { Deallocate(ptr, false); }
+void operator delete(void* ptr, std::align_val_t) noexcept { Deallocate(ptr, true); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { Deallocate(ptr, true); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { Deallocate(ptr, true); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept { Deallocate(ptr, true); }
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { Deallocate(ptr, true); }
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { Deallocate(ptr, true); }
\ No newline at end of file
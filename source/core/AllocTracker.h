@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+
+// Subsystems memory is charged to. Threads start as Other; scopes nest.
+enum class AllocTag : uint8_t {
+    Other,
+    Audio,
+    Library,
+    Art,
+    Lyrics,
+    Gui,
+    Count
+};
+
+const char* AllocTagName(AllocTag tag);
+
+// Opt-in: the global operator new/delete only count when the process starts
+// with VESPER_TRACK_ALLOCS=1. It is read at the first allocation, before main,
+// so every block has the same layout for the whole run.
+bool AllocTrackingEnabled();
+
+// Charges allocations made on this thread to `tag` until it goes out of
+// scope. Jobs run under the tag of the code that submitted them.
+class AllocScope {
+public:
+    explicit AllocScope(AllocTag tag);
+    ~AllocScope();
+
+    AllocScope(const AllocScope&) = delete;
+    AllocScope& operator=(const AllocScope&) = delete;
+
+private:
+    AllocTag m_previous;
+};
+
+AllocTag CurrentAllocTag();
+
+struct AllocStats {
+    int64_t liveBytes = 0;
+    int64_t peakBytes = 0;
+    int64_t liveBlocks = 0;
+    uint64_t allocations = 0; // since start
+    uint64_t totalBytes = 0;  // since start
+};
+
+AllocStats GetAllocStats(AllocTag tag);
+
+// Heap in use that did not come from operator new: FFmpeg's av_malloc,
+// OpenAL, curl, stb. FFmpeg has no allocator hook, so this is as close as it
+// gets. -1 where the C library cannot tell.
+int64_t UntrackedHeapBytes();
\ No newline at end of file
@@ -0,0 +1,114 @@
+#include "JobSystem.h"
+#include <algorithm>
+
+JobSystem::JobSystem(unsigned workers) {
+    if (workers == 0) {
+        unsigned hw = std::thread::hardware_concurrency();
+        workers = std::clamp(hw > 1 ? hw - 1 : 1u, 2u, 8u);
+    }
+
+    m_workers.reserve(workers);
+    for (unsigned i = 0; i < workers; ++i) {
+        m_workers.emplace_back(&JobSystem::workerThread, this, i != 0);
+    }
+}
+
+JobSystem::~JobSystem() {
+    shutdown();
+}
+
+void JobSystem::submit(JobPriority priority, Job job) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) return;
+        m_queues[static_cast<size_t>(priority)].push_back({ CancelToken(), std::move(job), false, CurrentAllocTag() });
+    }
+    m_cv.notify_all(); // the reserved worker may be the one woken for background work
+}
+
+void JobSystem::submit(JobPriority priority, CancelToken token, Job job) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) return;
+        m_queues[static_cast<size_t>(priority)].push_back({ std::move(token), std::move(job), true, CurrentAllocTag() });
+    }
+    m_cv.notify_all();
+}
+
+void JobSystem::postToMainThread(Job fn) {
+    std::function<void()> wakeup;
+    {
+        std::lock_guard<std::mutex> lock(m_mainMutex);
+        m_mainQueue.push_back(std::move(fn));
+        wakeup = m_wakeup;
+    }
+    if (wakeup) wakeup();
+}
+
+bool JobSystem::drainMainThread() {
+    std::vector<Job> jobs;
+    {
+        std::lock_guard<std::mutex> lock(m_mainMutex);
+        jobs.swap(m_mainQueue);
+    }
+    for (auto& job : jobs) job();
+    return !jobs.empty();
+}
+
+void JobSystem::setMainThreadWakeup(std::function<void()> wakeup) {
+    std::lock_guard<std::mutex> lock(m_mainMutex);
+    m_wakeup = std::move(wakeup);
+}
+
+void JobSystem::wakeMainThread() {
+    std::function<void()> wakeup;
+    {
+        std::lock_guard<std::mutex> lock(m_mainMutex);
+        wakeup = m_wakeup;
+    }
+    if (wakeup) wakeup();
+}
+
+void JobSystem::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) return;
+        m_running = false;
+        for (auto& queue : m_queues) queue.clear();
+    }
+    m_cv.notify_all();
+    for (auto& worker : m_workers) {
+        if (worker.joinable()) worker.join();
+    }
+}
+
+bool JobSystem::popJob(bool takesBackground, Entry& out) {
+    size_t last = takesBackground ? NUM_PRIORITIES : static_cast<size_t>(JobPriority::Background);
+    for (size_t p = 0; p < last; ++p) {
+        auto& queue = m_queues[p];
+        while (!queue.empty()) {
+            out = std::move(queue.front());
+            queue.pop_front();
+            if (!out.cancellable || !out.token.cancelled()) return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::workerThread(bool takesBackground) {
+    for (;;) {
+        Entry entry;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [&] { return !m_running || popJob(takesBackground, entry); });
+            if (!m_running) return;
+        }
+        AllocScope scope(entry.tag);
+        entry.job();
+    }
+}
+
+JobSystem& GetJobSystem() {
+    static JobSystem jobs;
+    return jobs;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "AllocTracker.h"
+
+enum class JobPriority {
+    Playback,   // anything the listener would hear being late
+    UI,         // results the user is waiting to see (art, lyrics of the current track)
+    Background, // prefetch, thumbnails, scans
+    Count
+};
+
+// Shared flag a job polls to find out it has been superseded
+class CancelToken {
+public:
+    CancelToken() : m_cancelled(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void cancel() const { m_cancelled->store(true); }
+    bool cancelled() const { return m_cancelled->load(); }
+
+private:
+    std::shared_ptr<std::atomic<bool>> m_cancelled;
+};
+
+// Fixed pool of workers fed from per-priority queues. One worker never takes
+// background work, so playback and UI jobs are not stuck behind a long scan.
+// Results meant for the GUI go through postToMainThread().
+class JobSystem {
+public:
+    using Job = std::function<void()>;
+
+    explicit JobSystem(unsigned workers = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    void submit(JobPriority priority, Job job);
+    // Dropped without running if the token is cancelled before a worker picks it up
+    void submit(JobPriority priority, CancelToken token, Job job);
+
+    // Queues fn for the GUI thread; runs at the next drainMainThread()
+    void postToMainThread(Job fn);
+    bool drainMainThread();
+
+    // Called after something is posted, e.g. to wake an idle event loop
+    void setMainThreadWakeup(std::function<void()> wakeup);
+    // Runs the wakeup without posting, for results the GUI thread polls itself
+    void wakeMainThread();
+
+    // Drops queued jobs and joins the workers
+    void shutdown();
+
+    unsigned workerCount() const { return static_cast<unsigned>(m_workers.size()); }
+
+private:
+    struct Entry {
+        CancelToken token;
+        Job job;
+        bool cancellable;
+        AllocTag tag; // of the submitter, so its jobs are charged to it
+    };
+
+    void workerThread(bool takesBackground);
+    bool popJob(bool takesBackground, Entry& out);
+
+    static constexpr size_t NUM_PRIORITIES = static_cast<size_t>(JobPriority::Count);
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<Entry> m_queues[NUM_PRIORITIES];
+    bool m_running = true;
+
+    std::mutex m_mainMutex;
+    std::vector<Job> m_mainQueue;
+    std::function<void()> m_wakeup;
+};
+
+// Process-wide pool, created on first use
+JobSystem& GetJobSystem();
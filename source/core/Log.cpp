@@ -0,0 +1,253 @@
+#include "Log.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+std::atomic<LogLevel> g_logLevel{ LogLevel::Info };
+
+namespace {
+
+using SystemClock = std::chrono::system_clock;
+
+struct Message {
+    uint64_t sequence = 0;
+    SystemClock::time_point time;
+    LogLevel level = LogLevel::Info;
+    std::string text;
+};
+
+// Written by its thread only, read by the writer only
+class ThreadBuffer {
+public:
+    static constexpr size_t CAPACITY = 256;
+
+    bool push(Message&& message) {
+        size_t write = m_write.load(std::memory_order_relaxed);
+        if (write - m_read.load(std::memory_order_acquire) == CAPACITY) return false;
+        m_slots[write % CAPACITY] = std::move(message);
+        m_write.store(write + 1, std::memory_order_release);
+        return true;
+    }
+
+    void drainInto(std::vector<Message>& out) {
+        size_t read = m_read.load(std::memory_order_relaxed);
+        size_t write = m_write.load(std::memory_order_acquire);
+        for (; read != write; ++read) out.push_back(std::move(m_slots[read % CAPACITY]));
+        m_read.store(read, std::memory_order_release);
+    }
+
+    bool empty() const { return m_read.load(std::memory_order_acquire) == m_write.load(std::memory_order_acquire); }
+    size_t size() const { return m_write.load(std::memory_order_acquire) - m_read.load(std::memory_order_acquire); }
+
+    std::atomic<bool> orphaned{ false }; // its thread has exited
+
+private:
+    Message m_slots[CAPACITY];
+    std::atomic<size_t> m_write{ 0 };
+    std::atomic<size_t> m_read{ 0 };
+};
+
+const char* LevelTag(LogLevel level) {
+    switch (level) {
+        case LogLevel::Debug:   return "D";
+        case LogLevel::Info:    return "I";
+        case LogLevel::Warning: return "W";
+        default:                return "E";
+    }
+}
+
+void FormatLine(std::string& out, const Message& message) {
+    std::time_t seconds = SystemClock::to_time_t(message.time);
+    std::tm local{};
+#ifdef _WIN32
+    localtime_s(&local, &seconds);
+#else
+    localtime_r(&seconds, &local);
+#endif
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(message.time.time_since_epoch()).count() % 1000;
+    char prefix[32];
+    std::snprintf(prefix, sizeof(prefix), "%02d:%02d:%02d.%03d [%s] ",
+                  local.tm_hour, local.tm_min, local.tm_sec, static_cast<int>(ms), LevelTag(message.level));
+    out += prefix;
+    out += message.text;
+    out += '\n';
+}
+
+class Logger {
+public:
+    Logger() : m_writer(&Logger::writerThread, this) {}
+    ~Logger() { shutdown(); }
+
+    bool running() const { return m_running.load(); }
+
+    void write(LogLevel level, std::string text) {
+        Message message{ m_sequence.fetch_add(1, std::memory_order_relaxed), SystemClock::now(), level, std::move(text) };
+        ThreadBuffer& buffer = threadBuffer();
+
+        // Full: give the writer a moment, then drop rather than stall the caller
+        for (int attempt = 0; !buffer.push(std::move(message)); ++attempt) {
+            if (attempt == 50) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            m_wake.notify_one();
+            std::this_thread::yield();
+        }
+        if (level >= LogLevel::Warning || buffer.size() > ThreadBuffer::CAPACITY / 2) m_wake.notify_one();
+    }
+
+    bool setFile(const std::string& path) {
+        std::lock_guard<std::mutex> lock(m_drainMutex);
+        if (m_file) std::fclose(m_file);
+        m_file = nullptr;
+        if (path.empty()) return true;
+#ifdef _WIN32
+        _wfopen_s(&m_file, std::filesystem::u8path(path).wstring().c_str(), L"a");
+#else
+        m_file = std::fopen(path.c_str(), "a");
+#endif
+        return m_file != nullptr;
+    }
+
+    void flush() {
+        std::lock_guard<std::mutex> lock(m_drainMutex);
+        drainLocked();
+    }
+
+    void shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+            if (!m_running.exchange(false)) return;
+        }
+        m_wake.notify_one();
+        if (m_writer.joinable()) m_writer.join();
+        flush();
+        std::lock_guard<std::mutex> lock(m_drainMutex);
+        if (m_file) std::fclose(m_file);
+        m_file = nullptr;
+    }
+
+private:
+    struct BufferHandle {
+        std::shared_ptr<ThreadBuffer> buffer;
+        ~BufferHandle() {
+            if (buffer) buffer->orphaned.store(true);
+        }
+    };
+
+    ThreadBuffer& threadBuffer() {
+        thread_local BufferHandle handle;
+        if (!handle.buffer) {
+            handle.buffer = std::make_shared<ThreadBuffer>();
+            std::lock_guard<std::mutex> lock(m_registryMutex);
+            m_buffers.push_back(handle.buffer);
+        }
+        return *handle.buffer;
+    }
+
+    void writerThread() {
+        while (m_running.load()) {
+            {
+                std::unique_lock<std::mutex> lock(m_wakeMutex);
+                m_wake.wait_for(lock, std::chrono::milliseconds(50));
+            }
+            flush();
+        }
+    }
+
+    // One consumer at a time: the writer, or a caller of flush()
+    void drainLocked() {
+        m_batch.clear();
+        {
+            std::lock_guard<std::mutex> lock(m_registryMutex);
+            for (const auto& buffer : m_buffers) buffer->drainInto(m_batch);
+            m_buffers.erase(std::remove_if(m_buffers.begin(), m_buffers.end(),
+                [](const auto& buffer) { return buffer->orphaned.load() && buffer->empty(); }), m_buffers.end());
+        }
+        uint64_t dropped = m_dropped.exchange(0, std::memory_order_relaxed);
+        if (m_batch.empty() && dropped == 0) return;
+
+        std::sort(m_batch.begin(), m_batch.end(),
+            [](const Message& a, const Message& b) { return a.sequence < b.sequence; });
+        m_text.clear();
+        for (const Message& message : m_batch) FormatLine(m_text, message);
+        if (dropped > 0)
+            FormatLine(m_text, { 0, SystemClock::now(), LogLevel::Warning, std::to_string(dropped) + " log messages dropped" });
+
+        std::fwrite(m_text.data(), 1, m_text.size(), stderr);
+        std::fflush(stderr);
+        if (m_file) {
+            std::fwrite(m_text.data(), 1, m_text.size(), m_file);
+            std::fflush(m_file);
+        }
+    }
+
+    std::atomic<bool> m_running{ true };
+    std::atomic<uint64_t> m_sequence{ 0 };
+    std::atomic<uint64_t> m_dropped{ 0 };
+
+    std::mutex m_registryMutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> m_buffers;
+
+    std::mutex m_drainMutex; // also guards the file and the scratch buffers below
+    std::FILE* m_file = nullptr;
+    std::vector<Message> m_batch;
+    std::string m_text;
+
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;
+    std::thread m_writer; // last, started once everything above exists
+};
+
+Logger& GetLogger() {
+    static Logger logger;
+    return logger;
+}
+
+} // namespace
+
+void SetLogLevel(LogLevel level) {
+    g_logLevel.store(level, std::memory_order_relaxed);
+}
+
+bool ParseLogLevel(const std::string& name, LogLevel& level) {
+    static const std::pair<const char*, LogLevel> names[] = {
+        { "debug", LogLevel::Debug }, { "info", LogLevel::Info }, { "warning", LogLevel::Warning },
+        { "error", LogLevel::Error }, { "off", LogLevel::Off },
+    };
+    for (const auto& [text, value] : names) {
+        if (name == text) {
+            level = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SetLogFile(const std::string& path) {
+    return GetLogger().setFile(path);
+}
+
+void LogWrite(LogLevel level, std::string message) {
+    Logger& logger = GetLogger();
+    if (!logger.running()) {
+        std::fprintf(stderr, "%s\n", message.c_str());
+        return;
+    }
+    logger.write(level, std::move(message));
+}
+
+void FlushLog() {
+    GetLogger().flush();
+}
+
+void ShutdownLog() {
+    GetLogger().shutdown();
+}
\ No newline at end of file
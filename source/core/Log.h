@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+enum class LogLevel : uint8_t {
+    Debug,
+    Info,
+    Warning,
+    Error,
+    Off
+};
+
+// Levels below this are compiled out, e.g. -DVESPER_LOG_MIN_LEVEL=1 drops Debug
+#ifndef VESPER_LOG_MIN_LEVEL
+#define VESPER_LOG_MIN_LEVEL 0
+#endif
+
+extern std::atomic<LogLevel> g_logLevel;
+
+// A disabled level costs this check and nothing else; the message is not built
+inline bool LogEnabled(LogLevel level) {
+    return level >= static_cast<LogLevel>(VESPER_LOG_MIN_LEVEL) && level >= g_logLevel.load(std::memory_order_relaxed);
+}
+
+// Info unless set, e.g. from VESPER_LOG_LEVEL or --log-level
+void SetLogLevel(LogLevel level);
+// "debug", "info", "warning", "error" or "off"
+bool ParseLogLevel(const std::string& name, LogLevel& level);
+// Appends to this file as well as stderr; an empty path stops
+bool SetLogFile(const std::string& path);
+
+// Queues on the calling thread's own buffer and returns; a background
+// thread writes the lines of all threads in the order they were logged
+void LogWrite(LogLevel level, std::string message);
+// Writes out everything queued so far
+void FlushLog();
+// Flushes and stops the writer; later messages go straight to stderr
+void ShutdownLog();
+
+#define VESPER_LOG(level, expr)                                  \
+    do {                                                         \
+        if (LogEnabled(level)) {                                 \
+            std::ostringstream vesperLogStream;                  \
+            vesperLogStream << expr;                             \
+            LogWrite(level, vesperLogStream.str());              \
+        }                                                        \
+    } while (0)
+
+#define LOG_DEBUG(expr) VESPER_LOG(LogLevel::Debug, expr)
+#define LOG_INFO(expr) VESPER_LOG(LogLevel::Info, expr)
+#define LOG_WARNING(expr) VESPER_LOG(LogLevel::Warning, expr)
+#define LOG_ERROR(expr) VESPER_LOG(LogLevel::Error, expr)
\ No newline at end of file
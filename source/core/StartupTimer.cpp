@@ -0,0 +1,36 @@
+#include "StartupTimer.h"
+#include <algorithm>
+#include <cstdio>
+
+static double Milliseconds(StartupTimer::Clock::duration d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+void StartupTimer::record(const std::string& name, Clock::time_point start, Clock::time_point end) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.push_back({ name, Milliseconds(start - m_origin), Milliseconds(end - start) });
+}
+
+double StartupTimer::elapsedMs() const {
+    return Milliseconds(Clock::now() - m_origin);
+}
+
+void StartupTimer::report(const char* milestone) {
+    double total = elapsedMs();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_reported) return;
+    m_reported = true;
+
+    std::sort(m_entries.begin(), m_entries.end(),
+        [](const Entry& a, const Entry& b) { return a.startMs < b.startMs; });
+
+    std::printf("Startup: %s after %.1f ms\n", milestone, total);
+    for (const Entry& e : m_entries)
+        std::printf("  %-20s %8.1f ms  (at %.1f ms)\n", e.name.c_str(), e.durationMs, e.startMs);
+    std::fflush(stdout);
+}
+
+StartupTimer& GetStartupTimer() {
+    static StartupTimer timer;
+    return timer;
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Wall-clock timing of startup phases, which may run on several threads.
+// Times are relative to the first GetStartupTimer() call, made first thing in main.
+class StartupTimer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    class Phase {
+    public:
+        Phase(StartupTimer& timer, std::string name) : m_timer(timer), m_name(std::move(name)), m_start(Clock::now()) {}
+        ~Phase() { m_timer.record(m_name, m_start, Clock::now()); }
+
+        Phase(const Phase&) = delete;
+        Phase& operator=(const Phase&) = delete;
+
+    private:
+        StartupTimer& m_timer;
+        std::string m_name;
+        Clock::time_point m_start;
+    };
+
+    StartupTimer() : m_origin(Clock::now()) {}
+
+    void record(const std::string& name, Clock::time_point start, Clock::time_point end);
+    double elapsedMs() const;
+
+    // Prints every phase once, with start offsets so overlap is visible
+    void report(const char* milestone);
+
+private:
+    struct Entry {
+        std::string name;
+        double startMs;
+        double durationMs;
+    };
+
+    Clock::time_point m_origin;
+    std::mutex m_mutex;
+    std::vector<Entry> m_entries;
+    bool m_reported = false;
+};
+
+StartupTimer& GetStartupTimer();
\ No newline at end of file
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// Fast non-cryptographic 64-bit hash for content keys (cover art, cache entries)
+
+inline uint64_t HashMix(uint64_t x) {
+    // splitmix64 finalizer
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27; x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+inline uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0) {
+    const auto* p = static_cast<const unsigned char*>(data);
+    uint64_t h = seed ^ (size * 0x9e3779b97f4a7c15ull);
+
+    while (size >= 8) {
+        uint64_t k;
+        std::memcpy(&k, p, 8);
+        h = (h ^ HashMix(k)) * 0x9e3779b97f4a7c15ull;
+        h = (h << 29) | (h >> 35);
+        p += 8;
+        size -= 8;
+    }
+
+    uint64_t tail = 0;
+    std::memcpy(&tail, p, size);
+    return HashMix(h ^ HashMix(tail ^ size));
+}
@@ -1,9 +1,10 @@
 // TO-DO: replace win32api/zenity with nfd (crossplatform)
 
 #include "files.h"
-#include <iostream>
+#include "Log.h"
 #include <algorithm>
 #include <set>
+#include <cstdlib>
 
 #ifdef _WIN32
     #include <windows.h>
@@ -76,6 +77,67 @@ std::string GetResourcePath(const std::string& relative) {
     return GetExecutableDirectory() + "/" + relative;
 }
 
+// Per-user directory for playlists and other saved state, created on first use
+std::string GetDataDirectory()
+{
+    std::filesystem::path dir;
+
+#ifdef _WIN32
+    if (const char* appData = std::getenv("APPDATA"))
+        dir = std::filesystem::u8path(appData) / "Vesper";
+#elif __APPLE__
+    if (const char* home = std::getenv("HOME"))
+        dir = std::filesystem::u8path(home) / "Library/Application Support/Vesper";
+#else
+    if (const char* xdg = std::getenv("XDG_DATA_HOME"); xdg && *xdg)
+        dir = std::filesystem::u8path(xdg) / "vesper";
+    else if (const char* home = std::getenv("HOME"))
+        dir = std::filesystem::u8path(home) / ".local/share/vesper";
+#endif
+
+    if (dir.empty())
+    {
+        // Fallback: next to the executable
+        dir = std::filesystem::u8path(GetExecutableDirectory()) / "data";
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    return dir.u8string();
+}
+
+// Per-user directory for data that can be rebuilt (thumbnails, lyrics), created on first use
+std::string GetCacheDirectory()
+{
+    std::filesystem::path dir;
+
+    // Explicit override, e.g. to keep test runs away from the user's cache
+    if (const char* overrideDir = std::getenv("VESPER_CACHE_DIR"); overrideDir && *overrideDir)
+        dir = std::filesystem::u8path(overrideDir);
+#ifdef _WIN32
+    else if (const char* localAppData = std::getenv("LOCALAPPDATA"))
+        dir = std::filesystem::u8path(localAppData) / "Vesper/Cache";
+#elif __APPLE__
+    else if (const char* home = std::getenv("HOME"))
+        dir = std::filesystem::u8path(home) / "Library/Caches/Vesper";
+#else
+    else if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg)
+        dir = std::filesystem::u8path(xdg) / "vesper";
+    else if (const char* home = std::getenv("HOME"))
+        dir = std::filesystem::u8path(home) / ".cache/vesper";
+#endif
+
+    if (dir.empty())
+    {
+        // Fallback: next to the executable
+        dir = std::filesystem::u8path(GetExecutableDirectory()) / "cache";
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    return dir.u8string();
+}
+
 
 std::string OpenFileDialog() {
 #ifdef _WIN32
@@ -158,26 +220,39 @@ std::string OpenFolderDialog() {
 }
 
 
-// Scans a directory, extracts tags from all supported audio files.
-// Returns a map: full path -> metadata.
-std::unordered_map<std::string, AudioMetadata> AddAudioFilesFromDirectory(const std::string& directory) {
-    std::unordered_map<std::string, AudioMetadata> metadataMap;
+// Lists supported audio files in a directory, sorted by path. No tags are read.
+std::vector<std::string> ListAudioFiles(const std::string& directory) {
+    std::vector<std::string> files;
 
     try {
         for (const auto& entry : std::filesystem::directory_iterator(directory)) {
-            if (entry.is_regular_file() && IsSupportedAudioFile(entry.path())) {
-                std::string path = entry.path().u8string();
-                if (metadataMap.find(path) == metadataMap.end()) {
-                    std::string title, artist, album, date_str;
-                    int year;
-                    ReadAudioTags(path.c_str(), &title, &artist, &album, &year, &date_str);
-                    metadataMap[path] = {title, artist, album, year, date_str};
-                }
-            }
+            if (entry.is_regular_file() && IsSupportedAudioFile(entry.path()))
+                files.push_back(entry.path().u8string());
         }
     } catch (const std::exception& e) {
-        std::cerr << "Error scanning directory: " << e.what() << std::endl;
+        LOG_ERROR("Error scanning directory: " << e.what());
     }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+// Reads the tags of one audio file
+AudioMetadata ReadAudioMetadata(const std::string& path) {
+    std::string title, artist, album, date_str, albumArtist;
+    int year, track;
+    double duration;
+    ReadAudioTags(path.c_str(), &title, &artist, &album, &year, &date_str, &track, &duration, &albumArtist);
+    AudioMetadata meta{title, artist, album, year, track, date_str, duration};
+    meta.albumArtist = std::move(albumArtist);
+    return meta;
+}
+
+// Scans a directory, extracts tags from all supported audio files.
+// Returns a map: full path -> metadata.
+std::unordered_map<std::string, AudioMetadata> AddAudioFilesFromDirectory(const std::string& directory) {
+    std::unordered_map<std::string, AudioMetadata> metadataMap;
+    for (const std::string& path : ListAudioFiles(directory))
+        metadataMap[path] = ReadAudioMetadata(path);
     return metadataMap;
 }
 
@@ -188,10 +263,7 @@ std::unordered_map<std::string, AudioMetadata> AddAudioFile(const std::string& f
     std::filesystem::path p(filePath);
     if (std::filesystem::is_regular_file(p) && IsSupportedAudioFile(p)) {
         std::string pathStr = p.u8string();
-        std::string title, artist, album, date_str;
-        int year;
-        ReadAudioTags(pathStr.c_str(), &title, &artist, &album, &year, &date_str);
-        metadataMap[pathStr] = {title, artist, album, year, date_str};
+        metadataMap[pathStr] = ReadAudioMetadata(pathStr);
     }
     return metadataMap;
 }
\ No newline at end of file
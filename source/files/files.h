@@ -13,17 +13,25 @@ struct AudioMetadata {
     std::string artist;
     std::string album;
     int year;
+    int track = 0;
     std::string date_str;
+    double duration = 0.0; // seconds, 0 if unknown
     std::string plainLyrics;
     GLuint albumArtTexture = 0;
+    std::string albumArtist; // empty when the file has no album artist tag
 };
 
 std::string OpenFileDialog();
 std::string OpenFolderDialog();
 std::string GetExecutableDirectory();
 std::string GetResourcePath(const std::string& relative);
+std::string GetDataDirectory();
+std::string GetCacheDirectory();
 
 std::unordered_map<std::string, AudioMetadata> AddAudioFilesFromDirectory(const std::string& directory);
+// Supported files in a directory, sorted by path; no tags are read
+std::vector<std::string> ListAudioFiles(const std::string& directory);
+AudioMetadata ReadAudioMetadata(const std::string& path);
 std::unordered_map<std::string, AudioMetadata> AddAudioFile(const std::string& filePath);
 
 bool IsSupportedAudioFile(const std::filesystem::path& path);
\ No newline at end of file
@@ -1,34 +1,115 @@
 #include "loadFonts.h"
-#include <iostream>
+#include "Log.h"
 #include <filesystem>
+#include <cstdlib>
 
 #ifdef _WIN32
     #include <windows.h>
 #else
     #include <unistd.h>
     #include <limits.h>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
 #endif
 
-// Global pointers to loaded font variants
-ImFont* g_RubikRegular = nullptr;
-ImFont* g_RubikMedium   = nullptr;
-ImFont* g_RubikLarge    = nullptr;
+ImFont* g_Rubik = nullptr;
+
+// Read-only view of a whole file. CJK fonts are 15-30 MB and only a few
+// glyphs are ever drawn, so they are mapped instead of read; pages are
+// faulted in as glyphs get rasterized. The mapping lives as long as the atlas.
+static bool MapFontFile(const std::string& path, void*& data, size_t& size) {
+#ifdef _WIN32
+    std::wstring wpath = std::filesystem::u8path(path).wstring();
+    HANDLE file = CreateFileW(wpath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER fileSize;
+    HANDLE mapping = nullptr;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+        mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping) return false;
+    data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    size = static_cast<size_t>(fileSize.QuadPart);
+    return data != nullptr;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    void* view = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) return false;
+    data = view;
+    size = static_cast<size_t>(st.st_size);
+    return true;
+#endif
+}
+
+// First CJK-capable system font found; VESPER_CJK_FONT overrides the search
+static std::string FindCjkFont() {
+    if (const char* path = std::getenv("VESPER_CJK_FONT"); path && *path) return path;
+
+    static const char* const candidates[] = {
+#ifdef _WIN32
+        "C:/Windows/Fonts/msyh.ttc",
+        "C:/Windows/Fonts/YuGothM.ttc",
+        "C:/Windows/Fonts/malgun.ttf",
+#elif __APPLE__
+        "/System/Library/Fonts/Hiragino Sans GB.ttc",
+        "/System/Library/Fonts/STHeiti Medium.ttc",
+        "/Library/Fonts/Arial Unicode.ttf",
+#else
+        "/usr/share/fonts/opentype/noto/NotoSansCJK-Medium.ttc",
+        "/usr/share/fonts/opentype/noto/NotoSansCJK-Regular.ttc",
+        "/usr/share/fonts/noto-cjk/NotoSansCJK-Medium.ttc",
+        "/usr/share/fonts/noto-cjk/NotoSansCJK-Regular.ttc",
+        "/usr/share/fonts/google-noto-cjk/NotoSansCJK-Regular.ttc",
+        "/usr/share/fonts/truetype/wqy/wqy-microhei.ttc",
+        "/usr/share/fonts/truetype/droid/DroidSansFallbackFull.ttf",
+#endif
+    };
+
+    std::error_code ec;
+    for (const char* candidate : candidates) {
+        if (std::filesystem::exists(std::filesystem::u8path(candidate), ec)) return candidate;
+    }
+    return {};
+}
+
+// Merged into the font added just before, so CJK tags render in Rubik's place
+static void MergeCjkFallback(ImGuiIO& io, float size) {
+    std::string path = FindCjkFont();
+    if (path.empty()) return;
+
+    void* data = nullptr;
+    size_t dataSize = 0;
+    if (!MapFontFile(path, data, dataSize)) {
+        LOG_WARNING("Failed to map CJK font: " << path);
+        return;
+    }
 
-void LoadRubikFont(ImGuiIO& io) {
-    std::string fontPath = GetResourcePath("fonts/rubik/Rubik-Medium.ttf");
     ImFontConfig config;
-    config.OversampleH = 3;
-    config.OversampleV = 1;
-    config.PixelSnapH = true;
+    config.MergeMode = true;
+    config.FontDataOwnedByAtlas = false; // the mapping is never unmapped
+    if (!io.Fonts->AddFontFromMemoryTTF(data, static_cast<int>(dataSize), size, &config))
+        LOG_WARNING("Failed to load CJK font: " << path);
+}
 
-    // Latin + Cyrillic ranges
-    static const ImWchar ranges[] = { 0x0020, 0x00FF, 0x0400, 0x052F, 0 };
+void LoadRubikFont(ImGuiIO& io) {
+    std::string fontPath = GetResourcePath("fonts/rubik/Rubik-Medium.ttf");
 
-    g_RubikRegular = io.Fonts->AddFontFromFileTTF(fontPath.c_str(), 16.0f, &config, ranges);
-    g_RubikMedium  = io.Fonts->AddFontFromFileTTF(fontPath.c_str(), 18.0f, &config, ranges);
-    g_RubikLarge   = io.Fonts->AddFontFromFileTTF(fontPath.c_str(), 28.0f, &config, ranges);
+    // With the dynamic atlas there are no ranges or sizes to bake up front:
+    // glyphs are rasterized at the size they are first drawn at
+    g_Rubik = io.Fonts->AddFontFromFileTTF(fontPath.c_str(), FONT_SIZE_REGULAR);
+    if (!g_Rubik) {
+        LOG_WARNING("Failed to load Rubik font: " << fontPath);
+        return;
+    }
 
-    if (!g_RubikRegular) std::cerr << "Failed to load Rubik font: " << fontPath << std::endl;
+    MergeCjkFallback(io, FONT_SIZE_REGULAR);
 }
 
 void LoadFontAwesome(ImGuiIO& io) {
@@ -39,8 +120,7 @@ void LoadFontAwesome(ImGuiIO& io) {
     config.MergeMode = true;
     config.PixelSnapH = true;
 
-    static const ImWchar icon_ranges[] = { 0xf000, 0xf8ff, 0 };
-
-    if (!io.Fonts->AddFontFromFileTTF(faPath.c_str(), 16.0f, &config, icon_ranges))
-        std::cerr << "Failed to load FontAwesome: " << faPath << std::endl;
+    // Only the icons actually drawn get rasterized
+    if (!io.Fonts->AddFontFromFileTTF(faPath.c_str(), 16.0f, &config))
+        LOG_WARNING("Failed to load FontAwesome: " << faPath);
 }
\ No newline at end of file
@@ -4,9 +4,12 @@
 #include "files.h"
 #include <string>
 
-extern ImFont* g_RubikRegular;
-extern ImFont* g_RubikMedium;
-extern ImFont* g_RubikLarge;
+// Rubik is loaded once; ImGui rasterizes each size the first time it is drawn
+extern ImFont* g_Rubik;
+
+constexpr float FONT_SIZE_REGULAR = 16.0f;
+constexpr float FONT_SIZE_MEDIUM  = 18.0f;
+constexpr float FONT_SIZE_LARGE   = 28.0f;
 
 void LoadRubikFont(ImGuiIO& io);
 void LoadFontAwesome(ImGuiIO& io);
\ No newline at end of file
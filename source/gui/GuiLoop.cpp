@@ -10,426 +10,951 @@ AudioEngine g_audio;
 
 std::string activeFilePath;
 std::string activeFileLyrics;
+std::vector<LyricLine> activeSyncedLyrics; // empty when only plain text is known
+static int shownLyricLine = -2;            // -2 forces a scroll after new lyrics
+static bool activeTagsPending = false;     // playing track not reached by the tag scan yet
 std::atomic<bool> lyricsLoading(false);
 std::atomic<GLuint> activeAlbumArtTexture{0};
 std::atomic<bool> albumArtLoading{false};
 
-struct AlbumArtData {
-    std::vector<unsigned char> data;
-};
-std::optional<AlbumArtData> pendingAlbumArt;
+// VRAM budget for cached covers, overridable with VESPER_ART_CACHE_MB
+static size_t AlbumArtCacheBudget() {
+    if (const char* mb = std::getenv("VESPER_ART_CACHE_MB")) {
+        long value = std::strtol(mb, nullptr, 10);
+        if (value > 0) return size_t(value) * 1024 * 1024;
+    }
+    return AlbumArtCache::DEFAULT_BUDGET;
+}
+
+std::atomic<GLuint> activeAlbumArtThumb{0};
+
+AlbumArtCache albumArtCache(AlbumArtCacheBudget());
+
+// Replaced on every track change; cancelling drops the previous track's work
+CancelToken albumArtJob;
+CancelToken lyricsJob;
+CancelToken prefetchJob;
+constexpr size_t PREFETCH_TRACKS = 3;
+
+// Idle rendering: frames drawn after any wakeup, and the redraw period while playing
+constexpr int ACTIVE_FRAMES = 3;
+constexpr double POSITION_TICK = 0.25;
+static int activeFrames = ACTIVE_FRAMES; // frames left to draw before sleeping again
+
+static bool albumGrid = false;
+
+// Session: saved on exit and every SESSION_SAVE_INTERVAL seconds while anything changes
+constexpr double SESSION_SAVE_INTERVAL = 30.0;
+static float trackListScrollY = 0.0f;
+static float pendingScrollY = -1.0f; // restored offset, applied once the list has a size
+
+// F12 shows the profiler; replay mode (--replay) keeps it recording without a window
+FrameProfiler frameProfiler;
+static bool showProfiler = false;
+static bool showMemory = false;
+static bool replaying = false;
+constexpr float REPLAY_SCROLL_STEP = 157.0f; // not a multiple of the row height
+
+// Both sizes live in the texture cache; the small one under a derived key
+static uint64_t SmallCoverKey(uint64_t hash) {
+    return HashMix(hash ^ COVER_SMALL_SIZE);
+}
+
+// GUI thread: show the covers of the current track (hash 0: it has none)
+static void ApplyAlbumArt(const CoverThumbnails& art) {
+    FrameProfiler::CpuScope scope(frameProfiler, "Album art upload");
+    AllocScope alloc(AllocTag::Art);
+    GLuint tex = 0, thumb = 0;
+    if (art.hash != 0) {
+        // Same cover as a recent track: reuse its textures, nothing to upload
+        tex = albumArtCache.acquire(art.hash);
+        if (!tex) {
+            tex = UploadTextureRGBA(art.large.pixels.data(), art.large.width, art.large.height);
+            albumArtCache.insert(art.hash, tex, art.large.pixels.size());
+        }
+        thumb = albumArtCache.acquire(SmallCoverKey(art.hash));
+        if (!thumb) {
+            thumb = UploadTextureRGBA(art.small.pixels.data(), art.small.width, art.small.height);
+            albumArtCache.insert(SmallCoverKey(art.hash), thumb, art.small.pixels.size());
+        }
+    }
+    activeAlbumArtTexture.store(tex);
+    activeAlbumArtThumb.store(thumb);
+}
 
 void LoadAlbumArtAsync(const std::string& filePath) {
+    albumArtJob.cancel();
+    albumArtJob = CancelToken();
     albumArtLoading = true;
-    pendingAlbumArt.reset();
 
-    std::thread([filePath]() {
-        AVFormatContext* fmt_ctx = nullptr;
-        if (avformat_open_input(&fmt_ctx, filePath.c_str(), nullptr, nullptr) < 0) {
-            albumArtLoading = false;
-            return;
-        }
-        if (avformat_find_stream_info(fmt_ctx, nullptr) < 0) {
-            avformat_close_input(&fmt_ctx);
+    // Decode and downscale on a worker, so the GUI thread only uploads small buffers
+    CancelToken token = albumArtJob;
+    GetJobSystem().submit(JobPriority::UI, token, [filePath, token]() {
+        AllocScope alloc(AllocTag::Art);
+        CoverThumbnails thumbs;
+        if (!LoadCoverThumbnails(filePath, thumbs)) thumbs = CoverThumbnails{};
+        if (token.cancelled()) return;
+
+        GetJobSystem().postToMainThread([token, thumbs = std::move(thumbs)]() {
+            if (token.cancelled()) return; // superseded by a newer track
+            ApplyAlbumArt(thumbs);
             albumArtLoading = false;
-            return;
-        }
+        });
+    });
+}
 
-        for (unsigned int i = 0; i < fmt_ctx->nb_streams; ++i) {
-            AVStream* stream = fmt_ctx->streams[i];
-            if (stream->disposition & AV_DISPOSITION_ATTACHED_PIC) {
-                AVPacket* pkt = &stream->attached_pic;
-                if (pkt->data && pkt->size > 0) {
-                    pendingAlbumArt = AlbumArtData{
-                        std::vector<unsigned char>(pkt->data, pkt->data + pkt->size)
-                    };
-                    break;
+CoverAtlas coverAtlas;
+
+struct AlbumEntry {
+    TrackId firstTrack;
+    uint32_t trackCount;
+};
+
+// Albums in album sort order, rebuilt when the library or its tags change
+static const std::vector<AlbumEntry>& LibraryAlbums(const Library& library) {
+    static std::vector<AlbumEntry> albums;
+    static uint64_t builtForRevision = ~uint64_t(0);
+    if (library.revision() == builtForRevision) return albums;
+
+    albums.clear();
+    TrackId previous = INVALID_TRACK;
+    for (TrackId id : library.order(SortColumn::Album)) {
+        if (previous == INVALID_TRACK || !library.sameAlbum(previous, id)) albums.push_back({ id, 0 });
+        albums.back().trackCount++;
+        previous = id;
+    }
+    builtForRevision = library.revision();
+    return albums;
+}
+
+static void UpdateCurrentTrackMetadata();
+
+static void DrawAlbumGrid(const Library& library) {
+    const float cellWidth = CoverAtlas::CELL_SIZE + 30.0f;
+    const float cellHeight = CoverAtlas::CELL_SIZE + 50.0f;
+    const auto& albums = LibraryAlbums(library);
+
+    int columns = std::max(1, static_cast<int>((ImGui::GetContentRegionAvail().x - 10.0f) / cellWidth));
+    int rows = static_cast<int>((albums.size() + columns - 1) / columns);
+
+    // Only visible rows are laid out, and only they request covers
+    ImGuiListClipper clipper;
+    clipper.Begin(rows, cellHeight);
+    while (clipper.Step()) {
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+            float rowY = ImGui::GetCursorPosY();
+            for (int col = 0; col < columns; ++col) {
+                size_t index = static_cast<size_t>(row) * columns + col;
+                if (index >= albums.size()) break;
+                const AlbumEntry& album = albums[index];
+                const AudioMetadata& meta = library.metadata(album.firstTrack);
+
+                ImGui::PushID(static_cast<int>(index));
+                ImGui::SetCursorPos(ImVec2(10.0f + col * cellWidth + 15.0f, rowY + 8.0f));
+                ImVec2 p_min = ImGui::GetCursorScreenPos();
+                ImVec2 p_max = ImVec2(p_min.x + CoverAtlas::CELL_SIZE, p_min.y + CoverAtlas::CELL_SIZE);
+
+                if (ImGui::InvisibleButton("##album", ImVec2(CoverAtlas::CELL_SIZE, CoverAtlas::CELL_SIZE))) {
+                    // Play from the album's first track and keep going through the album
+                    g_audio.ShowLibrary();
+                    g_audio.setSortColumn(SortColumn::Album);
+                    g_audio.loadAndPlay(library.path(album.firstTrack));
+                    UpdateCurrentTrackMetadata();
+                }
+
+                ImDrawList* dl = ImGui::GetWindowDrawList();
+                CoverAtlas::Image image;
+                if (coverAtlas.get(album.firstTrack, library.path(album.firstTrack), image)) {
+                    dl->AddImageRounded(image.texture, p_min, p_max, image.uv0, image.uv1, IM_COL32(255,255,255,255), 6.0f);
+                } else {
+                    dl->AddRectFilled(p_min, p_max, IM_COL32(45, 45, 52, 255), 6.0f);
                 }
+                if (ImGui::IsItemHovered()) dl->AddRect(p_min, p_max, IM_COL32(66, 128, 240, 255), 6.0f, 0, 2.0f);
+
+                ImVec2 textPos = ImVec2(p_min.x - 10.0f, p_max.y + 4.0f);
+                ImVec4 clip = ImVec4(textPos.x, textPos.y, textPos.x + cellWidth - 4.0f, textPos.y + 2 * ImGui::GetTextLineHeight());
+                // Untagged albums are grouped by folder, so they are named after it
+                std::string title = HasAlbumTag(meta) ? meta.album
+                    : std::filesystem::u8path(library.path(album.firstTrack)).parent_path().filename().u8string();
+                const std::string& artist = meta.albumArtist.empty() ? meta.artist : meta.albumArtist;
+                dl->AddText(nullptr, 0.0f, textPos, IM_COL32(235, 235, 242, 255), title.c_str(), nullptr, 0.0f, &clip);
+                textPos.y += ImGui::GetTextLineHeight();
+                dl->AddText(nullptr, 0.0f, textPos, IM_COL32(178, 178, 190, 255), artist.c_str(), nullptr, 0.0f, &clip);
+
+                ImGui::PopID();
             }
+            ImGui::SetCursorPos(ImVec2(0.0f, rowY));
+            ImGui::Dummy(ImVec2(1.0f, cellHeight - ImGui::GetStyle().ItemSpacing.y));
         }
-        avformat_close_input(&fmt_ctx);
-        albumArtLoading = false;
-    }).detach();
+    }
+    clipper.End();
+}
+
+// Warm the lyrics and thumbnail caches for what plays next, so the switch is instant
+static void PrefetchUpcomingTracks()
+{
+    prefetchJob.cancel();
+    prefetchJob = CancelToken();
+
+    std::vector<TrackId> upcoming = g_audio.upcomingTracks(PREFETCH_TRACKS);
+    auto library = g_audio.GetLibrary(); // after the ids, so it knows all of them
+    for (TrackId id : upcoming) {
+        const AudioMetadata& meta = library->metadata(id);
+        GetJobSystem().submit(JobPriority::Background, prefetchJob,
+            [path = library->path(id), title = meta.title, artist = meta.artist, duration = meta.duration]() {
+                {
+                    AllocScope alloc(AllocTag::Art);
+                    CoverThumbnails thumbs;
+                    LoadCoverThumbnails(path, thumbs);
+                }
+                AllocScope alloc(AllocTag::Lyrics);
+                if (!title.empty() && !getLocalLyrics(path)) getLyrics(artist, title, duration);
+            });
+    }
 }
 
 static void UpdateCurrentTrackMetadata()
 {
+    lyricsJob.cancel();
+    activeTagsPending = false;
+
     std::string currentPath = g_audio.currentFile();
     if (currentPath.empty()) {
         activeFilePath.clear();
         activeFileLyrics.clear();
+        activeSyncedLyrics.clear();
         lyricsLoading = false;
         return;
     }
     activeFilePath = currentPath;
 
-    const auto& cache = g_audio.GetMetadataCache();
-    auto it = cache.find(currentPath);
-    if (it == cache.end()) {
+    auto library = g_audio.GetLibrary();
+    TrackId id = library->find(currentPath);
+    if (id == INVALID_TRACK) {
         activeFileLyrics = "No metadata";
+        activeSyncedLyrics.clear();
         lyricsLoading = false;
         return;
     }
 
-    const AudioMetadata& meta = it->second;
+    const AudioMetadata& meta = library->metadata(id);
+    activeTagsPending = meta.title.empty() && g_audio.pendingTags() > 0;
+
+    lyricsJob = CancelToken();
+    lyricsLoading = true;
+    activeFileLyrics.clear();
+    activeSyncedLyrics.clear();
+
+    CancelToken token = lyricsJob;
+    GetJobSystem().submit(JobPriority::UI, token,
+        [token, path = currentPath, title = meta.title, artist = meta.artist, duration = meta.duration]() {
+        AllocScope alloc(AllocTag::Lyrics);
+        // A sidecar file wins over lrclib and needs no network
+        auto optLyrics = getLocalLyrics(path);
+        if (!optLyrics) optLyrics = getLyrics(artist, title, duration);
+
+        std::string lyrics;
+        std::vector<LyricLine> synced;
+        if (optLyrics.has_value()) {
+            synced = ParseLrc(optLyrics->syncedLyrics);
+            if (optLyrics->plainLyrics.empty() && !synced.empty())
+                optLyrics->plainLyrics = LyricLinesToText(synced);
+            lyrics = optLyrics->plainLyrics.empty() ? "Lyrics empty" : std::move(optLyrics->plainLyrics);
+        } else {
+            lyrics = "No lyrics found";
+        }
 
-    if (!lyricsLoading.load()) {
-        lyricsLoading = true;
-        activeFileLyrics.clear();
+        GetJobSystem().postToMainThread([token, lyrics = std::move(lyrics), synced = std::move(synced)]() mutable {
+            if (token.cancelled()) return; // superseded by a newer track
+            activeFileLyrics = std::move(lyrics);
+            activeSyncedLyrics = std::move(synced);
+            shownLyricLine = -2;
+            lyricsLoading = false;
+        });
+    });
 
-        std::thread([title = meta.title, artist = meta.artist]() {
-            auto optLyrics = getLyrics(artist, title);
-            
-            if (optLyrics.has_value()) {
-                activeFileLyrics = std::move(optLyrics.value());
-                if (activeFileLyrics.empty()) {
-                    activeFileLyrics = "Lyrics empty";
-                }
-            } else {
-                activeFileLyrics = "No lyrics found";
-            }
+    LoadAlbumArtAsync(currentPath);
+    PrefetchUpcomingTracks();
+}
 
-            lyricsLoading = false;
-        }).detach();
+// Highlights the line at the playback position and keeps it in view
+static void DrawSyncedLyrics()
+{
+    int current = CurrentLyricLine(activeSyncedLyrics, g_audio.position());
+    bool lineChanged = current != shownLyricLine;
+
+    for (int i = 0; i < static_cast<int>(activeSyncedLyrics.size()); ++i) {
+        const ImVec4 color = i == current ? ImVec4(1.0f, 1.0f, 1.0f, 1.0f)
+                                          : ImVec4(0.55f, 0.55f, 0.6f, 1.0f);
+        ImGui::PushStyleColor(ImGuiCol_Text, color);
+        ImGui::TextWrapped("%s", activeSyncedLyrics[i].text.empty() ? " " : activeSyncedLyrics[i].text.c_str());
+        ImGui::PopStyleColor();
+
+        if (i == current && lineChanged) ImGui::SetScrollHereY(0.4f);
     }
+    if (current < 0 && lineChanged) ImGui::SetScrollY(0.0f);
 
-    LoadAlbumArtAsync(currentPath);
+    shownLyricLine = current;
 }
 
-void GuiLoop(GLFWwindow* window) {
-    while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
+// How long the UI may sleep before the screen changes without input:
+// the position slider ticks slowly, synced lyrics switch lines on time.
+// Negative when nothing moves on its own.
+static double IdleTimeout()
+{
+    if (!g_audio.isPlaying()) return -1.0;
+
+    double timeout = POSITION_TICK;
+    if (!activeSyncedLyrics.empty()) {
+        double position = g_audio.position();
+        size_t next = static_cast<size_t>(CurrentLyricLine(activeSyncedLyrics, position) + 1);
+        if (next < activeSyncedLyrics.size())
+            timeout = std::min(timeout, std::max(0.01, activeSyncedLyrics[next].time - position));
+    }
+    return timeout;
+}
+
+// One complete frame: playback state, finished jobs, UI and render
+static void DrawFrame(GLFWwindow* window)
+{
+    frameProfiler.beginFrame();
+    AllocScope alloc(AllocTag::Gui);
 
-        static std::string lastPlayedFile = "";
-        std::string currentPlayedFile = g_audio.currentFile();
+    // One snapshot of each for the whole frame; the engine may publish newer ones meanwhile.
+    // Tracks reach the library before any playback state refers to them, so read that first.
+    std::shared_ptr<const PlaybackState> playback = g_audio.playbackState();
+    std::shared_ptr<const Library> librarySnapshot = g_audio.GetLibrary();
+    const Library& library = *librarySnapshot;
 
-        if (currentPlayedFile != lastPlayedFile) {
-            if (!currentPlayedFile.empty()) {
-                UpdateCurrentTrackMetadata();
-            }
-            else {
-                activeFilePath.clear();
-                activeFileLyrics.clear();
-                GLuint old = activeAlbumArtTexture.load();
-                if (old) glDeleteTextures(1, &old);
-                activeAlbumArtTexture.store(0);
-            }
-            lastPlayedFile = currentPlayedFile;
+    static std::string lastPlayedFile = "";
+    const std::string& currentPlayedFile = playback->currentFile;
+
+    if (currentPlayedFile != lastPlayedFile) {
+        if (!currentPlayedFile.empty()) {
+            UpdateCurrentTrackMetadata();
+        }
+        else {
+            activeFilePath.clear();
+            activeFileLyrics.clear();
+            activeSyncedLyrics.clear();
+            albumArtJob.cancel();
+            lyricsJob.cancel();
+            prefetchJob.cancel();
+            activeAlbumArtTexture.store(0); // textures stay in the cache
+            activeAlbumArtThumb.store(0);
         }
+        lastPlayedFile = currentPlayedFile;
+    }
+    // Started before the background scan reached it: look up lyrics again with the real tags
+    if (activeTagsPending && playback->currentTrack < library.size() &&
+        !library.metadata(playback->currentTrack).title.empty()) {
+        UpdateCurrentTrackMetadata();
+    }
+
+
+    ImGuiIO& io = ImGui::GetIO();
+    ImGui_ImplOpenGL3_NewFrame();
+    ImGui_ImplGlfw_NewFrame();
+
+    frameProfiler.beginCpu("Cover atlas");
+    if (coverAtlas.update()) activeFrames = std::max(activeFrames, 1);
+    frameProfiler.endCpu();
+
+    frameProfiler.beginCpu("Main-thread jobs");
+    if (GetJobSystem().drainMainThread()) activeFrames = ACTIVE_FRAMES; // finished art and lyrics jobs
+    frameProfiler.endCpu();
+
+    ImGui::NewFrame();
+    ImGui::PushFont(io.Fonts->Fonts[1]);
+    
+    ImGui::SetNextWindowSize(ImVec2(600, 350));
+    ImGui::SetNextWindowPos(ImVec2(0, 270), ImGuiCond_Always);
+
+    ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0, 0));
+    ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0, 0));
 
+    ImGui::Begin("files", nullptr,
+        ImGuiWindowFlags_NoResize |
+        ImGuiWindowFlags_NoBringToFrontOnFocus |
+        ImGuiWindowFlags_NoTitleBar |
+        ImGuiWindowFlags_NoScrollbar
+    );
 
-        ImGuiIO& io = ImGui::GetIO();
-        ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
+    ImGui::BeginChild("##Header", ImVec2(0, 45), true, ImGuiWindowFlags_NoScrollbar);
+    {
+        ImGui::SetCursorPos(ImVec2(12, 8));
+        ImGui::PushFont(io.Fonts->Fonts[0]);
+        ImGui::PushStyleVar(ImGuiStyleVar_FramePadding, ImVec2(12, 8));
+        ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(10, 10));
 
-        if (pendingAlbumArt.has_value()) {
-            GLuint old = activeAlbumArtTexture.load();
-            if (old) glDeleteTextures(1, &old);
-            GLuint tex = !pendingAlbumArt->data.empty()
-                ? LoadTextureFromMemory(pendingAlbumArt->data.data(), pendingAlbumArt->data.size())
-                : 0;
-            activeAlbumArtTexture.store(tex);
-            pendingAlbumArt.reset();
+        if (ImGui::Button(u8"\uf15b", ImVec2(40, 30))) {
+            std::string file = OpenFileDialog();
+            if (!file.empty()) g_audio.AddFile(file);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button(u8"\uf07b", ImVec2(40, 30))) {
+            std::string folder = OpenFolderDialog();
+            if (!folder.empty()) g_audio.AddFilesFromDirectory(folder);
+        }
+        ImGui::SameLine();
+        ImGui::PushStyleColor(ImGuiCol_Button, albumGrid ? ImVec4(0.1f, 0.3f, 0.7f, 1) : ImGui::GetStyleColorVec4(ImGuiCol_Button));
+        if (ImGui::Button(u8"\uf00a", ImVec2(40, 30))) albumGrid = !albumGrid;
+        ImGui::PopStyleColor();
+        ImGui::SameLine();
+        static std::vector<std::string> playlistNames;
+        if (ImGui::Button(u8"\uf03a", ImVec2(40, 30))) {
+            playlistNames = ListPlaylists();
+            ImGui::OpenPopup("##Playlists");
         }
 
-        ImGui::NewFrame();
-        ImGui::PushFont(io.Fonts->Fonts[1]);
-        
-        ImGui::SetNextWindowSize(ImVec2(600, 350));
-        ImGui::SetNextWindowPos(ImVec2(0, 270), ImGuiCond_Always);
-
-        ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0, 0));
-        ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0, 0));
-
-        ImGui::Begin("files", nullptr,
-            ImGuiWindowFlags_NoResize |
-            ImGuiWindowFlags_NoBringToFrontOnFocus |
-            ImGuiWindowFlags_NoTitleBar |
-            ImGuiWindowFlags_NoScrollbar
-        );
-
-        ImGui::BeginChild("##Header", ImVec2(0, 45), true, ImGuiWindowFlags_NoScrollbar);
-        {
-            ImGui::SetCursorPos(ImVec2(12, 8));
-            ImGui::PushFont(io.Fonts->Fonts[0]);
-            ImGui::PushStyleVar(ImGuiStyleVar_FramePadding, ImVec2(12, 8));
-            ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(10, 10));
-
-            if (ImGui::Button(u8"\uf15b", ImVec2(40, 30))) {
-                std::string file = OpenFileDialog();
-                if (!file.empty()) g_audio.AddFile(file);
+        ImGui::PopStyleVar(2);
+        ImGui::PopFont();
+
+        const Playlist* activePlaylist = playback->playlist.get();
+
+        ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(8, 8));
+        if (ImGui::BeginPopup("##Playlists")) {
+            if (ImGui::Selectable("Library", activePlaylist == nullptr)) g_audio.ShowLibrary();
+            ImGui::Separator();
+            for (const auto& name : playlistNames) {
+                if (ImGui::Selectable(name.c_str(), activePlaylist && activePlaylist->name == name))
+                    g_audio.LoadPlaylist(name);
             }
+            if (!playlistNames.empty()) ImGui::Separator();
+
+            static char newPlaylistName[128] = "";
+            ImGui::SetNextItemWidth(180);
+            ImGui::InputTextWithHint("##PlaylistName", "Save list as...", newPlaylistName, sizeof(newPlaylistName));
             ImGui::SameLine();
-            if (ImGui::Button(u8"\uf07b", ImVec2(40, 30))) {
-                std::string folder = OpenFolderDialog();
-                if (!folder.empty()) g_audio.AddFilesFromDirectory(folder);
+            if (ImGui::Button("Save") && newPlaylistName[0] != '\0') {
+                if (g_audio.SavePlaylist(newPlaylistName)) playlistNames = ListPlaylists();
+                newPlaylistName[0] = '\0';
             }
+            ImGui::EndPopup();
+        }
+        ImGui::PopStyleVar();
 
-            ImGui::PopStyleVar(2);
-            ImGui::PopFont();
+        ImGui::SameLine(0.0f, 20.0f);
+        ImGui::SetCursorPosY(12);
+        ImGui::SetNextItemWidth(120);
+        SortColumn sortColumn = g_audio.getSortColumn();
+        ImGui::BeginDisabled(activePlaylist != nullptr); // playlists keep their own order
+        if (ImGui::BeginCombo("##Sort", SortColumnName(sortColumn))) {
+            for (int c = 0; c < static_cast<int>(SortColumn::Count); ++c) {
+                auto column = static_cast<SortColumn>(c);
+                if (ImGui::Selectable(SortColumnName(column), column == sortColumn))
+                    g_audio.setSortColumn(column);
+            }
+            ImGui::EndCombo();
         }
-        ImGui::EndChild();
+        ImGui::EndDisabled();
 
-        ImGui::BeginChild("##TrackList", ImVec2(0, 0), false,
-            ImGuiWindowFlags_AlwaysVerticalScrollbar |
-            ImGuiWindowFlags_HorizontalScrollbar
-        );
+        if (activePlaylist) {
+            ImGui::SameLine(0.0f, 12.0f);
+            ImGui::TextColored(ImVec4(0.70f, 0.70f, 0.75f, 1.0f), "%s", activePlaylist->name.c_str());
+        }
+    }
+    ImGui::EndChild();
 
-        ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0, 2));
+    ImGui::BeginChild("##TrackList", ImVec2(0, 0), false,
+        ImGuiWindowFlags_AlwaysVerticalScrollbar |
+        ImGuiWindowFlags_HorizontalScrollbar
+    );
 
-        const auto& audioFiles = g_audio.GetAudioFiles();
-        const auto& metadataCache = g_audio.GetMetadataCache();
+    ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0, 2));
 
-        for (size_t i = 0; i < audioFiles.size(); ++i) {
-            const std::string& path = audioFiles[i];
-            const auto& meta = metadataCache.at(path);
+    if (replaying) ImGui::SetScrollY(std::fmod(ImGui::GetScrollY() + REPLAY_SCROLL_STEP, ImGui::GetScrollMaxY() + 1.0f));
+    if (pendingScrollY >= 0.0f && (ImGui::GetScrollMaxY() > 0.0f || ImGui::GetFrameCount() > ACTIVE_FRAMES)) {
+        ImGui::SetScrollY(std::min(pendingScrollY, ImGui::GetScrollMaxY()));
+        pendingScrollY = -1.0f;
+    }
+    trackListScrollY = ImGui::GetScrollY();
 
-            std::string display = meta.artist.empty() ? meta.title : meta.artist + " - " + meta.title;
-            if (display.empty()) display = std::filesystem::path(path).filename().string();
+    const Playlist* playlist = playback->playlist.get();
+    const auto& order = playlist ? playlist->tracks : library.order(g_audio.getSortColumn());
 
-            bool isPlaying = (activeFilePath == path);
+    if (albumGrid) {
+        frameProfiler.beginCpu("Album grid");
+        DrawAlbumGrid(library);
+        frameProfiler.endCpu();
+    }
 
-            ImGui::PushID(static_cast<int>(i));
+    // Only the visible rows are touched, so the cost does not grow with the library
+    frameProfiler.beginCpu("Track list");
+    TrackId playingId = playback->currentTrack;
+    const float rowHeight = 38.0f;
+    static std::vector<TrackId> visibleIds;
+    visibleIds.clear();
+    ImGuiListClipper clipper;
+    clipper.Begin(albumGrid ? 0 : static_cast<int>(order.size()), rowHeight + ImGui::GetStyle().ItemSpacing.y);
+    while (clipper.Step()) {
+        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+            const std::string& path = library.path(order[i]);
+            const std::string& display = library.displayName(order[i]);
+
+            bool isPlaying = (order[i] == playingId);
+            visibleIds.push_back(order[i]);
+
+            ImGui::PushID(i);
+            float rowY = ImGui::GetCursorPosY();
 
             if (isPlaying) {
                 ImVec2 p = ImGui::GetCursorScreenPos();
                 ImGui::GetWindowDrawList()->AddRectFilled(
-                    p, ImVec2(p.x + ImGui::GetWindowWidth(), p.y + 38),
+                    p, ImVec2(p.x + ImGui::GetWindowWidth(), p.y + rowHeight),
                     IM_COL32(34, 109, 217, 90), 6.0f);
             }
 
-            if (ImGui::Selectable("##sel", isPlaying, 0, ImVec2(0, 38))) {
+            if (ImGui::Selectable("##sel", isPlaying, 0, ImVec2(0, rowHeight))) {
                 activeFilePath = path;
-                g_audio.loadAndPlay(path);  
+                if (playlist) g_audio.playPlaylistEntry(i);
+                else g_audio.loadAndPlay(path);
                 UpdateCurrentTrackMetadata();
             }
 
-            ImGui::SetCursorPosY(ImGui::GetCursorPosY() - 38 + 10);
+            ImGui::SetCursorPosY(rowY + 12);
             ImGui::SetCursorPosX(16);
-            ImGui::TextColored(ImVec4(0.70f, 0.70f, 0.75f, 1.0f), "%02d", static_cast<int>(i + 1));
+            ImGui::TextColored(ImVec4(0.70f, 0.70f, 0.75f, 1.0f), "%02d", i + 1);
 
             ImGui::SameLine();
             ImGui::SetCursorPosX(50);
+            ImVec2 thumbMin = ImVec2(ImGui::GetCursorScreenPos().x, ImGui::GetCursorScreenPos().y - 6);
+            ImVec2 thumbMax = ImVec2(thumbMin.x + 30, thumbMin.y + 30);
+            CoverAtlas::Image image;
+            if (ImGui::IsRectVisible(thumbMin, thumbMax) && coverAtlas.get(order[i], path, image)) {
+                ImGui::GetWindowDrawList()->AddImageRounded(image.texture, thumbMin, thumbMax,
+                    image.uv0, image.uv1, IM_COL32(255,255,255,255), 4.0f);
+            }
+
+            ImGui::SameLine();
+            ImGui::SetCursorPosX(90);
             ImGui::TextColored(isPlaying ? ImVec4(1,1,1,1) : ImVec4(0.92f,0.92f,0.95f,1),
                                "%s", display.c_str());
 
+            // Keep every row exactly rowHeight tall so the clipper can skip rows by arithmetic
+            float pad = rowY + rowHeight - ImGui::GetCursorPosY();
+            if (pad > 0.0f) ImGui::Dummy(ImVec2(1.0f, pad));
+
             ImGui::PopID();
         }
+    }
+    clipper.End();
+    // Tags still being read: the rows on screen go to the front of the queue
+    if (!visibleIds.empty() && g_audio.pendingTags() > 0) g_audio.prioritizeTags(visibleIds);
+    frameProfiler.endCpu();
+
+    ImGui::PopStyleVar();
+    ImGui::EndChild();
+    ImGui::End();
+    ImGui::PopStyleVar(2);
+
+    
+    ImGui::SetNextWindowSize(ImVec2(300, 620));
+    ImGui::SetNextWindowPos(ImVec2(600, 0), ImGuiCond_Always);
+    ImGui::PushFont(io.Fonts->Fonts[1]);
+    ImGui::PushStyleVar(ImGuiStyleVar_FramePadding, ImVec2(10, 10));
+    ImGui::Begin("Now Playing", nullptr,
+        ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove |
+        ImGuiWindowFlags_NoBringToFrontOnFocus | ImGuiWindowFlags_NoTitleBar);
+
+    ImGui::SetCursorPos(ImVec2(10, 10));
+    ImGui::PushFont(g_Rubik, FONT_SIZE_LARGE);
+    ImGui::TextColored(ImVec4(1,1,1,1), "Now playing:");
+    ImGui::PopFont();
+
+    ImVec2 AlbumArtSize = ImVec2(250, 250);
+    GLuint tex = activeAlbumArtTexture.load();
+    if (tex!=0) {
+        ImVec2 p_min = ImGui::GetCursorScreenPos();
+        ImVec2 p_max = ImVec2(p_min.x + AlbumArtSize.x, p_min.y + AlbumArtSize.y);
+        ImDrawList* dl = ImGui::GetForegroundDrawList();
+        dl->AddImageRounded((ImTextureID)(intptr_t)tex, p_min, p_max, ImVec2(0,0), ImVec2(1,1), IM_COL32(255,255,255,255), 10.0f);
+        ImGui::Dummy(AlbumArtSize);
+    } else {
+        ImVec2 p_min = ImGui::GetCursorScreenPos();
+        ImVec2 p_max = ImVec2(p_min.x + AlbumArtSize.x, p_min.y + AlbumArtSize.y);
+        ImGui::Dummy(AlbumArtSize);
+        ImDrawList* drawList = ImGui::GetForegroundDrawList();
+        ImU32 borderColor = IM_COL32(255,255,255,255);
+        float borderThickness = 2.0f;
+        drawList->AddRect(p_min, p_max, borderColor, 0.0f, 0, borderThickness);
+    }
 
-        ImGui::PopStyleVar();
-        ImGui::EndChild();
-        ImGui::End();
-        ImGui::PopStyleVar(2);
+    auto getMeta = [&]() -> const AudioMetadata& {
+        static AudioMetadata empty;
+        if (activeFilePath.empty()) return empty;
+        TrackId id = library.find(activeFilePath);
+        return id != INVALID_TRACK ? library.metadata(id) : empty;
+    };
+    const auto& m = getMeta();
+
+    ImGui::PushFont(g_Rubik, FONT_SIZE_REGULAR); ImGui::Text("Title:"); ImGui::PopFont();
+    ImGui::PushFont(g_Rubik, FONT_SIZE_MEDIUM); ImGui::TextWrapped("%s", m.title.empty() ? "Unknown" : m.title.c_str()); ImGui::PopFont();
+    ImGui::Separator();
+
+    ImGui::PushFont(g_Rubik, FONT_SIZE_REGULAR); ImGui::Text("Artist:"); ImGui::PopFont();
+    ImGui::PushFont(g_Rubik, FONT_SIZE_MEDIUM); ImGui::TextWrapped("%s", m.artist.empty() ? "Unknown" : m.artist.c_str()); ImGui::PopFont();
+    ImGui::Separator();
+
+    ImGui::PushFont(g_Rubik, FONT_SIZE_REGULAR); ImGui::Text("Album:"); ImGui::PopFont();
+    ImGui::PushFont(g_Rubik, FONT_SIZE_MEDIUM); ImGui::TextWrapped("%s", m.album.empty() ? "Unknown" : m.album.c_str()); ImGui::PopFont();
+    ImGui::Separator();
+
+    ImGui::PushFont(g_Rubik, FONT_SIZE_REGULAR); ImGui::Text("Year:"); ImGui::PopFont();
+    ImGui::PushFont(g_Rubik, FONT_SIZE_MEDIUM); ImGui::Text("%d", m.year); ImGui::PopFont();
+
+    ImGui::End();
+    ImGui::PopStyleVar();
+    ImGui::PopFont();
+
+    
+    ImGui::SetNextWindowSize(ImVec2(380,620));
+    ImGui::SetNextWindowPos(ImVec2(900,0), ImGuiCond_FirstUseEver);
+    ImGui::Begin("lyrics", nullptr,
+        ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoResize |
+        ImGuiWindowFlags_NoBringToFrontOnFocus | ImGuiWindowFlags_NoTitleBar);
+    ImGui::SetCursorPos(ImVec2(10, 10));
+    ImGui::BeginChild("LyricsScroll", ImVec2(ImGui::GetWindowWidth()-20, ImGui::GetWindowHeight()-20),
+                       true, ImGuiWindowFlags_AlwaysVerticalScrollbar);
+    ImGui::PushFont(g_Rubik, FONT_SIZE_LARGE);
+    if (lyricsLoading) {
+        ImGui::Text("Loading text from lrclib.net...");
+    } else if (!activeSyncedLyrics.empty()) {
+        DrawSyncedLyrics();
+    } else if (!activeFileLyrics.empty()) {
+        ImGui::TextWrapped("%s", activeFileLyrics.c_str());
+    } else {
+        ImGui::Text("Here be lyrics");
+    }
+    ImGui::PopFont();
+    ImGui::EndChild();
+    ImGui::End();
+    
+    
+    ImGui::SetNextWindowSize(ImVec2(1280, 100));
+    ImGui::SetNextWindowPos(ImVec2(0, 620), ImGuiCond_Always);
+    ImGui::PushFont(io.Fonts->Fonts[1]);
+    ImGui::SetNextWindowContentSize(ImVec2(1280, 50));
+
+    ImGui::Begin("panel", nullptr,
+        ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove |
+        ImGuiWindowFlags_NoBringToFrontOnFocus | ImGuiWindowFlags_NoTitleBar
+    );
+
+    ImGui::SetCursorPos(ImVec2(10, 10));
+
+    GLuint thumb = activeAlbumArtThumb.load();
+    if (thumb) {
+        ImDrawList* dl = ImGui::GetForegroundDrawList();
+        ImVec2 p_min = ImGui::GetCursorScreenPos();
+        ImVec2 p_max = ImVec2(p_min.x + 80, p_min.y + 80);
+        dl->AddImageRounded((ImTextureID)(intptr_t)thumb, p_min, p_max, ImVec2(0,0), ImVec2(1,1), IM_COL32(255,255,255,255), 10.0f);
+    } else {
+        ImGui::Dummy(ImVec2(80, 80));
+        ImDrawList* dl = ImGui::GetForegroundDrawList();
+        dl->AddRect(ImVec2(10, 630), ImVec2(90, 710), IM_COL32(255,255,255,255), 0, 0, 2.0f);
+    }
 
-        
-        ImGui::SetNextWindowSize(ImVec2(300, 620));
-        ImGui::SetNextWindowPos(ImVec2(600, 0), ImGuiCond_Always);
-        ImGui::PushFont(io.Fonts->Fonts[1]);
-        ImGui::PushStyleVar(ImGuiStyleVar_FramePadding, ImVec2(10, 10));
-        ImGui::Begin("Now Playing", nullptr,
-            ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove |
-            ImGuiWindowFlags_NoBringToFrontOnFocus | ImGuiWindowFlags_NoTitleBar);
-
-        ImGui::SetCursorPos(ImVec2(10, 10));
-        if (g_RubikLarge) ImGui::PushFont(g_RubikLarge);
-        ImGui::TextColored(ImVec4(1,1,1,1), "Now playing:");
-        if (g_RubikLarge) ImGui::PopFont();
-
-        ImVec2 AlbumArtSize = ImVec2(250, 250);
-        GLuint tex = activeAlbumArtTexture.load();
-        if (tex!=0) {
-            ImVec2 p_min = ImGui::GetCursorScreenPos();
-            ImVec2 p_max = ImVec2(p_min.x + AlbumArtSize.x, p_min.y + AlbumArtSize.y);
-            ImDrawList* dl = ImGui::GetForegroundDrawList();
-            dl->AddImageRounded((ImTextureID)(intptr_t)tex, p_min, p_max, ImVec2(0,0), ImVec2(1,1), IM_COL32(255,255,255,255), 10.0f);
-            ImGui::Dummy(AlbumArtSize);
-        } else {
-            ImVec2 p_min = ImGui::GetCursorScreenPos();
-            ImVec2 p_max = ImVec2(p_min.x + AlbumArtSize.x, p_min.y + AlbumArtSize.y);
-            ImGui::Dummy(AlbumArtSize);
-            ImDrawList* drawList = ImGui::GetForegroundDrawList();
-            ImU32 borderColor = IM_COL32(255,255,255,255);
-            float borderThickness = 2.0f;
-            drawList->AddRect(p_min, p_max, borderColor, 0.0f, 0, borderThickness);
-        }
+    ImGui::SameLine();
+
+    ImGuiStyle& style = ImGui::GetStyle();
+    float originalItemSpacingY = style.ItemSpacing.y;
+    style.ItemSpacing.y = 0.5f;
+
+    ImGui::BeginGroup();
+    ImGui::Dummy(ImVec2(0.0f, 48.f));
+    ImGui::SetCursorPosX(98.f);
+    std::string activeTitle;
+    std::string activeArtist;
+    ImGui::Text("%s", m.title.empty() ? "Unknown" : m.title.c_str());
+    ImGui::SetCursorPosX(98.f);
+    float slideposx2 = ImGui::GetCursorPosX() + 270.f;
+    float slideposy2 = ImGui::GetCursorPosY() - 10.f;
+    ImGui::Text("%s", m.artist.empty() ? "Unknown" : m.artist.c_str());
+    ImGui::EndGroup();
+
+    style.ItemSpacing.y = originalItemSpacingY;
+    
+    ImGui::SetCursorPosX(98.f);
+    float currentTime = static_cast<float>(g_audio.position());
+    float trackLength = static_cast<float>(g_audio.duration());
+
+    ImGui::SetCursorPos(ImVec2(slideposx2, slideposy2));
+    ImGui::PushItemWidth(600);
+    if (ImGui::SliderFloat("##Track Position", &currentTime, 0.0f,
+                           trackLength > 0 ? trackLength : 1.0f, "Time: %.1f s")) {
+        g_audio.seek(currentTime);
+    }
+    ImGui::PopItemWidth();
+    
+    ImGui::SetCursorPos(ImVec2(550, 25));
+    ImGui::PushStyleVar(ImGuiStyleVar_FramePadding, ImVec2(0.f, 10.f));
+    ImGui::PushFont(io.Fonts->Fonts[0]);
+    
+    if (ImGui::Button(u8"\uf048", ImVec2(70, 30))) {
+        g_audio.playPrev();
+        UpdateCurrentTrackMetadata();
+    }
 
-        auto getMeta = [&]() -> const AudioMetadata& {
-            static AudioMetadata empty;
-            if (activeFilePath.empty()) return empty;
-            auto it = metadataCache.find(activeFilePath);
-            return it != metadataCache.end() ? it->second : empty;
-        };
-        const auto& m = getMeta();
+    ImGui::SameLine();
+    if (ImGui::Button(g_audio.isPlaying() ? u8"\uf04c" : u8"\uf04b", ImVec2(70, 30))) {
+        g_audio.playPause();
+    }
 
-        ImGui::PushFont(g_RubikRegular); ImGui::Text("Title:"); ImGui::PopFont();
-        ImGui::PushFont(g_RubikMedium); ImGui::TextWrapped("%s", m.title.empty() ? "Unknown" : m.title.c_str()); ImGui::PopFont();
-        ImGui::Separator();
+    ImGui::SameLine();
+    
+    if (ImGui::Button(u8"\uf051", ImVec2(70, 30))) {
+        g_audio.playNext();
+        UpdateCurrentTrackMetadata();
+    }
+    
+    ImGui::SetCursorPos(ImVec2(510, 25));
+    bool repeatOneState = g_audio.getRepeatOne();
+    ImGui::PushStyleColor(ImGuiCol_Button, repeatOneState ? ImVec4(0.1f, 0.3f, 0.7f, 1) : ImVec4(0.2f, 0.2f, 0.2f, 1));
+    if (ImGui::Button(u8"\uf01e", ImVec2(30, 30))) {
+        g_audio.setRepeatOne(!repeatOneState);
+    }
+    ImGui::PopStyleColor();
 
-        ImGui::PushFont(g_RubikRegular); ImGui::Text("Artist:"); ImGui::PopFont();
-        ImGui::PushFont(g_RubikMedium); ImGui::TextWrapped("%s", m.artist.empty() ? "Unknown" : m.artist.c_str()); ImGui::PopFont();
-        ImGui::Separator();
+    ImGui::SetCursorPos(ImVec2(785, 25));
+    bool shuffleState = g_audio.getShuffle();
+    ImGui::PushStyleColor(ImGuiCol_Button, shuffleState ? ImVec4(0.1f, 0.3f, 0.7f, 1) : ImVec4(0.2f, 0.2f, 0.2f, 1));
+    if (ImGui::Button(u8"\uf074", ImVec2(30, 30))) { 
+        g_audio.setShuffle(!shuffleState);
+    }
+    ImGui::PopStyleColor();
+
+    ImGui::PopFont();
+    ImGui::PopStyleVar();
+
+    float volume = g_audio.volume();
+    ImGui::SameLine();
+    ImGui::SetCursorPosX(slideposx2 + 655.f);
+    ImGui::SetCursorPosY(slideposy2 + 1.f);
+    ImGui::PushStyleVar(ImGuiStyleVar_FrameRounding, 5.0f);
+    ImGui::PushStyleVar(ImGuiStyleVar_FramePadding, ImVec2(5.0f, 4.0f));
+    ImGui::PushStyleVar(ImGuiStyleVar_GrabMinSize, 8.0f);
+    ImGui::PushItemWidth(150);
+    if (ImGui::SliderFloat("##Volume", &volume, 0.0f, 1.0f, "")) {
+        g_audio.setVolume(volume);
+    }
 
-        ImGui::PushFont(g_RubikRegular); ImGui::Text("Album:"); ImGui::PopFont();
-        ImGui::PushFont(g_RubikMedium); ImGui::TextWrapped("%s", m.album.empty() ? "Unknown" : m.album.c_str()); ImGui::PopFont();
-        ImGui::Separator();
+    // Tempo without pitch change; right click goes back to normal speed
+    float speed = g_audio.speed();
+    ImGui::SetCursorPosX(slideposx2 + 655.f);
+    if (ImGui::SliderFloat("##Speed", &speed, TimeStretch::MIN_SPEED, TimeStretch::MAX_SPEED, "%.2fx")) {
+        g_audio.setSpeed(speed);
+    }
+    if (ImGui::IsItemClicked(ImGuiMouseButton_Right)) g_audio.setSpeed(1.0f);
+    ImGui::PopItemWidth();
+    ImGui::PopStyleVar(3);
+
+    ImGui::PopFont();
+    ImGui::End();
+
+    
+    ImGui::SetNextWindowSize(ImVec2(600, 270), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowPos(ImVec2(0, 0), ImGuiCond_FirstUseEver);
+    ImGui::Begin("Visualizer", nullptr,
+                ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoResize |
+                ImGuiWindowFlags_NoBringToFrontOnFocus | ImGuiWindowFlags_NoTitleBar);
+
+    // to be implemented
+
+    ImGui::End();
+    ImGui::PopFont();
+
+    if (ImGui::IsKeyPressed(ImGuiKey_F12, false)) showProfiler = !showProfiler;
+    if (showProfiler) frameProfiler.drawWindow(&showProfiler);
+    if (ImGui::IsKeyPressed(ImGuiKey_F11, false)) showMemory = !showMemory;
+    if (showMemory) DrawMemoryWindow(&showMemory);
+    if (!replaying) frameProfiler.setEnabled(showProfiler);
+
+    frameProfiler.beginCpu("ImGui::Render");
+    ImGui::Render();
+    frameProfiler.endCpu();
+
+    glClearColor(0.110f, 0.110f, 0.125f, 1.000f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    frameProfiler.beginCpu("RenderDrawData");
+    frameProfiler.beginGpu("RenderDrawData");
+    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    frameProfiler.endGpu();
+    frameProfiler.endCpu();
+
+    frameProfiler.endFrame(); // before the swap, which waits for vsync
+    glfwSwapBuffers(window);
+}
 
-        ImGui::PushFont(g_RubikRegular); ImGui::Text("Year:"); ImGui::PopFont();
-        ImGui::PushFont(g_RubikMedium); ImGui::Text("%d", m.year); ImGui::PopFont();
+static Session CaptureSession()
+{
+    Session session = g_audio.captureSession();
+    session.scrollY = trackListScrollY;
+    session.albumGrid = albumGrid;
+    return session;
+}
 
-        ImGui::End();
-        ImGui::PopStyleVar();
-        ImGui::PopFont();
+// The list and the view come back before the first frame; opening and
+// pre-buffering the track waits for the disk, so it runs on a worker
+static void RestoreSession()
+{
+    Session session;
+    if (!LoadSession(session)) return;
 
-        
-        ImGui::SetNextWindowSize(ImVec2(380,620));
-        ImGui::SetNextWindowPos(ImVec2(900,0), ImGuiCond_FirstUseEver);
-        ImGui::Begin("lyrics", nullptr,
-            ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoResize |
-            ImGuiWindowFlags_NoBringToFrontOnFocus | ImGuiWindowFlags_NoTitleBar);
-        ImGui::SetCursorPos(ImVec2(10, 10));
-        ImGui::BeginChild("LyricsScroll", ImVec2(ImGui::GetWindowWidth()-20, ImGui::GetWindowHeight()-20),
-                           true, ImGuiWindowFlags_AlwaysVerticalScrollbar);
-        ImGui::PushFont(g_RubikLarge);
-        if (lyricsLoading) {
-            ImGui::Text("Loading text from lrclib.net...");
-        } else if (!activeFileLyrics.empty()) {
-            ImGui::TextWrapped("%s", activeFileLyrics.c_str());
-        } else {
-            ImGui::Text("Here be lyrics");
-        }
-        ImGui::PopFont();
-        ImGui::EndChild();
-        ImGui::End();
-        
-        
-        ImGui::SetNextWindowSize(ImVec2(1280, 100));
-        ImGui::SetNextWindowPos(ImVec2(0, 620), ImGuiCond_Always);
-        ImGui::PushFont(io.Fonts->Fonts[1]);
-        ImGui::SetNextWindowContentSize(ImVec2(1280, 50));
-
-        ImGui::Begin("panel", nullptr,
-            ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove |
-            ImGuiWindowFlags_NoBringToFrontOnFocus | ImGuiWindowFlags_NoTitleBar
-        );
-
-        ImGui::SetCursorPos(ImVec2(10, 10));
-
-        if (tex) {
-            ImDrawList* dl = ImGui::GetForegroundDrawList();
-            ImVec2 p_min = ImGui::GetCursorScreenPos();
-            ImVec2 p_max = ImVec2(p_min.x + 80, p_min.y + 80);
-            dl->AddImageRounded((ImTextureID)(intptr_t)tex, p_min, p_max, ImVec2(0,0), ImVec2(1,1), IM_COL32(255,255,255,255), 10.0f);
-        } else {
-            ImGui::Dummy(ImVec2(80, 80));
-            ImDrawList* dl = ImGui::GetForegroundDrawList();
-            dl->AddRect(ImVec2(10, 630), ImVec2(90, 710), IM_COL32(255,255,255,255), 0, 0, 2.0f);
-        }
+    g_audio.restoreSession(session);
+    albumGrid = session.albumGrid;
+    pendingScrollY = session.scrollY;
 
-        ImGui::SameLine();
+    if (!session.currentFile.empty()) {
+        GetJobSystem().submit(JobPriority::Playback, [file = session.currentFile, position = session.position]() {
+            if (g_audio.currentFile().empty()) g_audio.cue(file, position); // unless something was picked meanwhile
+        });
+    }
+}
 
-        ImGuiStyle& style = ImGui::GetStyle();
-        float originalItemSpacingY = style.ItemSpacing.y;
-        style.ItemSpacing.y = 0.5f;
-
-        ImGui::BeginGroup();
-        ImGui::Dummy(ImVec2(0.0f, 48.f));
-        ImGui::SetCursorPosX(98.f);
-        std::string activeTitle;
-        std::string activeArtist;
-        ImGui::Text("%s", m.title.empty() ? "Unknown" : m.title.c_str());
-        ImGui::SetCursorPosX(98.f);
-        float slideposx2 = ImGui::GetCursorPosX() + 270.f;
-        float slideposy2 = ImGui::GetCursorPosY() - 10.f;
-        ImGui::Text("%s", m.artist.empty() ? "Unknown" : m.artist.c_str());
-        ImGui::EndGroup();
-
-        style.ItemSpacing.y = originalItemSpacingY;
-        
-        ImGui::SetCursorPosX(98.f);
-        float currentTime = static_cast<float>(g_audio.position());
-        float trackLength = static_cast<float>(g_audio.duration());
-
-        ImGui::SetCursorPos(ImVec2(slideposx2, slideposy2));
-        ImGui::PushItemWidth(600);
-        if (ImGui::SliderFloat("##Track Position", &currentTime, 0.0f,
-                               trackLength > 0 ? trackLength : 1.0f, "Time: %.1f s")) {
-            g_audio.seek(currentTime);
-        }
-        ImGui::PopItemWidth();
-        
-        ImGui::SetCursorPos(ImVec2(550, 25));
-        ImGui::PushStyleVar(ImGuiStyleVar_FramePadding, ImVec2(0.f, 10.f));
-        ImGui::PushFont(io.Fonts->Fonts[0]);
-        
-        if (ImGui::Button(u8"\uf048", ImVec2(70, 30))) {
-            g_audio.playPrev();
-            UpdateCurrentTrackMetadata();
-        }
+// Written on a worker; skipped while nothing changes
+static void SaveSessionPeriodically()
+{
+    static double lastSave = glfwGetTime();
+    static uint64_t savedState = g_audio.stateVersion();
+    static float savedScroll = trackListScrollY;
+    static bool savedGrid = albumGrid;
+
+    double now = glfwGetTime();
+    if (now - lastSave < SESSION_SAVE_INTERVAL) return;
+    lastSave = now;
+
+    bool changed = g_audio.isPlaying() || g_audio.stateVersion() != savedState
+                || trackListScrollY != savedScroll || albumGrid != savedGrid;
+    if (!changed) return;
+    savedState = g_audio.stateVersion();
+    savedScroll = trackListScrollY;
+    savedGrid = albumGrid;
+
+    GetJobSystem().submit(JobPriority::Background, [session = CaptureSession()]() { SaveSession(session); });
+}
 
-        ImGui::SameLine();
-        if (ImGui::Button(g_audio.isPlaying() ? u8"\uf04c" : u8"\uf04b", ImVec2(70, 30))) {
-            g_audio.playPause();
-        }
+static void ShutdownGui()
+{
+    // Audio and worker threads outlive the window and GLFW; they must not wake it any more
+    GetJobSystem().setMainThreadWakeup(nullptr);
+    g_audio.setStateListener(nullptr);
+
+    activeAlbumArtTexture.store(0);
+    activeAlbumArtThumb.store(0);
+    albumArtCache.clear();
+    coverAtlas.shutdown(); // while the GL context is still alive
+    frameProfiler.shutdown();
+}
 
-        ImGui::SameLine();
-        
-        if (ImGui::Button(u8"\uf051", ImVec2(70, 30))) {
-            g_audio.playNext();
-            UpdateCurrentTrackMetadata();
-        }
-        
-        ImGui::SetCursorPos(ImVec2(510, 25));
-        bool repeatOneState = g_audio.getRepeatOne();
-        ImGui::PushStyleColor(ImGuiCol_Button, repeatOneState ? ImVec4(0.1f, 0.3f, 0.7f, 1) : ImVec4(0.2f, 0.2f, 0.2f, 1));
-        if (ImGui::Button(u8"\uf01e", ImVec2(30, 30))) {
-            g_audio.setRepeatOne(!repeatOneState);
+void GuiLoop(GLFWwindow* window) {
+    // Finished jobs and playback changes wake the loop out of glfwWaitEvents
+    GetJobSystem().setMainThreadWakeup([] { glfwPostEmptyEvent(); });
+    g_audio.setStateListener([] { glfwPostEmptyEvent(); });
+
+    RestoreSession();
+    GetJobSystem().submit(JobPriority::Background, [] { PruneThumbnailCache(); });
+
+    uint64_t seenState = g_audio.stateVersion();
+    bool firstFrame = true;
+
+    while (!glfwWindowShouldClose(window)) {
+        if (glfwGetWindowAttrib(window, GLFW_ICONIFIED)) {
+            // Nothing to draw; keep applying finished jobs until restored
+            glfwWaitEvents();
+            GetJobSystem().drainMainThread();
+            activeFrames = ACTIVE_FRAMES;
+            continue;
         }
-        ImGui::PopStyleColor();
 
-        ImGui::SetCursorPos(ImVec2(785, 25));
-        bool shuffleState = g_audio.getShuffle();
-        ImGui::PushStyleColor(ImGuiCol_Button, shuffleState ? ImVec4(0.1f, 0.3f, 0.7f, 1) : ImVec4(0.2f, 0.2f, 0.2f, 1));
-        if (ImGui::Button(u8"\uf074", ImVec2(30, 30))) { 
-            g_audio.setShuffle(!shuffleState);
+        if (activeFrames > 0) {
+            glfwPollEvents();
+            --activeFrames;
+        } else {
+            double timeout = IdleTimeout();
+            double start = glfwGetTime();
+            if (timeout < 0.0) glfwWaitEvents();
+            else glfwWaitEventsTimeout(timeout);
+
+            // Woken early by input or a wakeup: ImGui needs a few frames to settle hover and popups
+            if (timeout < 0.0 || glfwGetTime() - start < timeout) activeFrames = ACTIVE_FRAMES;
         }
-        ImGui::PopStyleColor();
 
-        ImGui::PopFont();
-        ImGui::PopStyleVar();
+        uint64_t state = g_audio.stateVersion();
+        if (state != seenState) {
+            seenState = state;
+            activeFrames = ACTIVE_FRAMES;
+        }
 
-        float volume = g_audio.volume();
-        ImGui::SameLine();
-        ImGui::SetCursorPosX(slideposx2 + 655.f);
-        ImGui::SetCursorPosY(slideposy2 + 1.f);
-        ImGui::PushStyleVar(ImGuiStyleVar_FrameRounding, 5.0f);
-        ImGui::PushStyleVar(ImGuiStyleVar_FramePadding, ImVec2(5.0f, 4.0f));
-        ImGui::PushStyleVar(ImGuiStyleVar_GrabMinSize, 8.0f);
-        ImGui::PushItemWidth(150);
-        if (ImGui::SliderFloat("##Volume", &volume, 0.0f, 1.0f, "")) {
-            g_audio.setVolume(volume);
+        DrawFrame(window);
+        SaveSessionPeriodically();
+        if (firstFrame) {
+            GetStartupTimer().report("first frame");
+            firstFrame = false;
         }
-        ImGui::PopItemWidth();
-        ImGui::PopStyleVar(3);
+    }
 
-        ImGui::PopFont();
-        ImGui::End();
+    SaveSession(CaptureSession());
+    ShutdownGui();
+}
 
-        
-        ImGui::SetNextWindowSize(ImVec2(600, 270), ImGuiCond_FirstUseEver);
-        ImGui::SetNextWindowPos(ImVec2(0, 0), ImGuiCond_FirstUseEver);
-        ImGui::Begin("Visualizer", nullptr,
-                    ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoResize |
-                    ImGuiWindowFlags_NoBringToFrontOnFocus | ImGuiWindowFlags_NoTitleBar);
+// Deterministic tags shaped like a real collection: 12-track albums, 4 albums per artist
+static std::unordered_map<std::string, AudioMetadata> SyntheticLibrary(size_t count)
+{
+    static const char* const words[] = {
+        "Night", "Echo", "Silver", "River", "Ghost", "Neon", "Winter", "Golden",
+        "Paper", "Signal", "Glass", "Ocean", "Static", "Velvet", "Hollow", "Summer"
+    };
+    auto phrase = [](uint64_t seed) {
+        uint64_t h = HashMix(seed);
+        return std::string(words[h & 15]) + " " + words[(h >> 4) & 15] + " " + words[(h >> 8) & 15];
+    };
+
+    std::unordered_map<std::string, AudioMetadata> tracks;
+    tracks.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        size_t album = i / 12;
+        size_t artist = album / 4;
+
+        AudioMetadata meta{};
+        meta.artist = "Artist " + std::to_string(artist);
+        meta.album = phrase(album) + " " + std::to_string(album);
+        meta.title = phrase(i + (uint64_t(1) << 40));
+        meta.year = 1970 + static_cast<int>(artist % 50);
+        meta.track = static_cast<int>(i % 12) + 1;
+        meta.date_str = std::to_string(meta.year);
+        meta.duration = 120.0 + static_cast<double>(i % 240);
+
+        std::string path = "/vesper-replay/" + meta.artist + "/" + meta.album + "/"
+                         + std::to_string(meta.track) + " " + meta.title + ".flac";
+        tracks.emplace(std::move(path), std::move(meta));
+    }
+    return tracks;
+}
 
-        // to be implemented
+int GuiReplay(GLFWwindow* window, int frames, size_t tracks)
+{
+    replaying = true;
+    frameProfiler.setEnabled(true);
+    glfwSwapInterval(0); // measure the work, not the display
 
-        ImGui::End();
-        ImGui::PopFont();
+    auto start = std::chrono::steady_clock::now();
+    g_audio.AddTracks(SyntheticLibrary(tracks));
+    double libraryMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 
-        ImGui::Render();
-        glClearColor(0.110f, 0.110f, 0.125f, 1.000f);
-        glClear(GL_COLOR_BUFFER_BIT);
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-        glfwSwapBuffers(window);
+    // First half scrolls the track list, second half the album grid
+    for (int i = 0; i < frames && !glfwWindowShouldClose(window); ++i) {
+        glfwPollEvents();
+        albumGrid = i >= frames / 2;
+        DrawFrame(window);
     }
+
+    glFinish();
+    frameProfiler.flush();
+    std::cout << "Replay: " << frames << " frames, " << g_audio.GetLibrary()->size() << " tracks"
+              << " (library built in " << libraryMs << " ms)\n"
+              << frameProfiler.report();
+
+    ShutdownGui();
+    return 0;
 }
\ No newline at end of file
@@ -8,11 +8,31 @@
 #include <thread>
 #include <atomic>
 #include <optional>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
 
 #include "files.h"
 #include "getlyrics.h"
+#include "lrc.h"
 #include "loadFonts.h"
 #include "albumArt.h"
+#include "albumArtCache.h"
+#include "thumbnails.h"
+#include "hash.h"
 #include "AudioEngine.h"
+#include "coverAtlas.h"
+#include "JobSystem.h"
+#include "frameProfiler.h"
+#include "memoryPanel.h"
+#include "StartupTimer.h"
 
-void GuiLoop(GLFWwindow* window);
\ No newline at end of file
+extern AudioEngine g_audio;
+
+void GuiLoop(GLFWwindow* window);
+
+// Draws `frames` frames back to back against a synthetic library of `tracks`
+// tracks, then prints the frame profiler report. Returns the exit code.
+int GuiReplay(GLFWwindow* window, int frames, size_t tracks);
\ No newline at end of file
@@ -0,0 +1,193 @@
+#include "coverAtlas.h"
+#include "JobSystem.h"
+#include <algorithm>
+
+namespace {
+
+// Requests that sat in the queue this many frames belong to rows scrolled away
+constexpr uint64_t STALE_FRAMES = 30;
+
+} // namespace
+
+CoverAtlas::~CoverAtlas() {
+    shutdown();
+}
+
+bool CoverAtlas::get(TrackId id, const std::string& path, Image& out) {
+    auto known = m_trackHash.find(id);
+    if (known != m_trackHash.end()) {
+        if (known->second == 0) return false;
+
+        auto cell = m_cellOf.find(known->second);
+        if (cell != m_cellOf.end()) {
+            Cell& c = m_cells[cell->second];
+            c.lastUsed = m_frame;
+
+            int page = cell->second / CELLS_PER_PAGE;
+            int slot = cell->second % CELLS_PER_PAGE;
+            float x = float((slot % CELLS_PER_ROW) * CELL_STRIDE + 1);
+            float y = float((slot / CELLS_PER_ROW) * CELL_STRIDE + 1);
+            out.texture = (ImTextureID)(intptr_t)m_pages[page];
+            out.uv0 = ImVec2((x + 0.5f) / PAGE_SIZE, (y + 0.5f) / PAGE_SIZE);
+            out.uv1 = ImVec2((x + c.width - 0.5f) / PAGE_SIZE, (y + c.height - 0.5f) / PAGE_SIZE);
+            return true;
+        }
+
+        auto waiting = m_waiting.find(known->second);
+        if (waiting != m_waiting.end()) {
+            waiting->second.lastWanted = m_frame;
+            return false;
+        }
+        // Evicted since; load it again below
+    }
+
+    if (m_pending.insert(id).second) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_requests.push_back({ id, path, m_frame });
+        }
+        // One job per request, each taking whichever request is newest when it runs
+        GetJobSystem().submit(JobPriority::Background, [this] { loadNewest(); });
+    }
+    return false;
+}
+
+bool CoverAtlas::update() {
+    AllocScope alloc(AllocTag::Art); // upload staging
+    ++m_frame;
+    m_loaderFrame.store(m_frame);
+
+    std::vector<Result> results;
+    bool more;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        size_t count = std::min<size_t>(m_results.size(), MAX_UPLOADS_PER_FRAME);
+        results.assign(std::make_move_iterator(m_results.begin()), std::make_move_iterator(m_results.begin() + count));
+        m_results.erase(m_results.begin(), m_results.begin() + count);
+        more = !m_results.empty();
+    }
+
+    // Place covers that were waiting for a cell; forget the ones scrolled away meanwhile
+    bool full = false;
+    for (auto it = m_waiting.begin(); it != m_waiting.end();) {
+        int cell = -1;
+        if (it->second.lastWanted + STALE_FRAMES < m_frame) {
+            it = m_waiting.erase(it);
+        } else if (!full && (cell = allocateCell()) >= 0) {
+            upload(cell, it->first, it->second.thumb);
+            it = m_waiting.erase(it);
+        } else {
+            full = true;
+            ++it;
+        }
+    }
+
+    for (Result& result : results) {
+        m_pending.erase(result.id);
+        if (result.skipped) continue;
+
+        m_trackHash[result.id] = result.hash;
+        if (result.hash == 0 || m_cellOf.count(result.hash) || m_waiting.count(result.hash)) continue; // no cover, or album already loaded
+
+        int cell = full ? -1 : allocateCell();
+        if (cell >= 0) {
+            upload(cell, result.hash, result.thumb);
+        } else {
+            // Every cell is on screen: keep the decoded cover rather than decoding it again next frame
+            full = true;
+            m_waiting[result.hash] = { std::move(result.thumb), m_frame };
+        }
+    }
+    return more;
+}
+
+int CoverAtlas::allocateCell() {
+    int capacity = MAX_PAGES * CELLS_PER_PAGE;
+    if (static_cast<int>(m_cells.size()) < capacity) {
+        int cell = static_cast<int>(m_cells.size());
+        if (cell % CELLS_PER_PAGE == 0) {
+            GLuint page;
+            glGenTextures(1, &page);
+            glBindTexture(GL_TEXTURE_2D, page);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, PAGE_SIZE, PAGE_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            m_pages.push_back(page);
+        }
+        m_cells.emplace_back();
+        return cell;
+    }
+
+    // Full: reuse the least recently drawn cell, unless everything is on screen
+    auto victim = std::min_element(m_cells.begin(), m_cells.end(),
+        [](const Cell& a, const Cell& b) { return a.lastUsed < b.lastUsed; });
+    if (victim->lastUsed >= m_frame - 1) return -1;
+
+    m_cellOf.erase(victim->hash);
+    return static_cast<int>(victim - m_cells.begin());
+}
+
+void CoverAtlas::upload(int cell, uint64_t hash, const Thumbnail& thumb) {
+    int w = std::min(thumb.width, CELL_SIZE);
+    int h = std::min(thumb.height, CELL_SIZE);
+
+    int slot = cell % CELLS_PER_PAGE;
+    glBindTexture(GL_TEXTURE_2D, m_pages[cell / CELLS_PER_PAGE]);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, thumb.width);
+    glTexSubImage2D(GL_TEXTURE_2D, 0,
+                    (slot % CELLS_PER_ROW) * CELL_STRIDE + 1, (slot / CELLS_PER_ROW) * CELL_STRIDE + 1,
+                    w, h, GL_RGBA, GL_UNSIGNED_BYTE, thumb.pixels.data());
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+    m_cells[cell] = { hash, w, h, m_frame };
+    m_cellOf[hash] = cell;
+}
+
+void CoverAtlas::loadNewest() {
+    AllocScope alloc(AllocTag::Art);
+    Request request;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running || m_requests.empty()) return;
+        request = std::move(m_requests.back());
+        m_requests.pop_back();
+    }
+
+    Result result{ request.id, false, 0, {} };
+    if (request.frame + STALE_FRAMES < m_loaderFrame.load()) {
+        result.skipped = true;
+    } else {
+        CoverThumbnails thumbs;
+        if (LoadCoverThumbnails(request.path, thumbs)) {
+            result.hash = thumbs.hash;
+            result.thumb = std::move(thumbs.small);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) return;
+        m_results.push_back(std::move(result));
+    }
+    GetJobSystem().wakeMainThread(); // an idle UI would not pick it up otherwise
+}
+
+void CoverAtlas::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+        m_requests.clear();
+        m_results.clear();
+    }
+
+    if (!m_pages.empty()) glDeleteTextures(static_cast<GLsizei>(m_pages.size()), m_pages.data());
+    m_pages.clear();
+    m_cells.clear();
+    m_cellOf.clear();
+    m_trackHash.clear();
+    m_pending.clear();
+    m_waiting.clear();
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <imgui.h>
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+#include <atomic>
+
+#include "Library.h"
+#include "thumbnails.h"
+
+// Small covers for lists and the album grid, packed into a few large atlas
+// pages instead of one texture per cover. Covers are loaded lazily for the
+// rows that ask for them and evicted least recently used first.
+class CoverAtlas {
+public:
+    static constexpr int CELL_SIZE = COVER_SMALL_SIZE;
+    static constexpr int CELL_STRIDE = CELL_SIZE + 2; // 1px gutter against filtering bleed
+    static constexpr int PAGE_SIZE = 2048;
+    static constexpr int CELLS_PER_ROW = PAGE_SIZE / CELL_STRIDE;
+    static constexpr int CELLS_PER_PAGE = CELLS_PER_ROW * CELLS_PER_ROW;
+    static constexpr int MAX_PAGES = 4;
+    static constexpr int MAX_UPLOADS_PER_FRAME = 24;
+
+    struct Image {
+        ImTextureID texture = 0;
+        ImVec2 uv0;
+        ImVec2 uv1;
+    };
+
+    CoverAtlas() = default;
+    ~CoverAtlas();
+
+    // GL thread. Returns false while the cover is loading or if there is none;
+    // the first call for a track queues its load.
+    bool get(TrackId id, const std::string& path, Image& out);
+
+    // GL thread, once per frame: uploads finished loads.
+    // Returns true if more are waiting for the next frame.
+    bool update();
+
+    // Stops loading and frees the pages; call while the GL context is alive
+    void shutdown();
+
+private:
+    struct Request {
+        TrackId id;
+        std::string path;
+        uint64_t frame;
+    };
+
+    struct Result {
+        TrackId id;
+        bool skipped; // dropped as stale, may be requested again
+        uint64_t hash;
+        Thumbnail thumb;
+    };
+
+    struct Cell {
+        uint64_t hash = 0;
+        int width = 0;
+        int height = 0;
+        uint64_t lastUsed = 0;
+    };
+
+    // Decoded while every cell was on screen; uploaded once one frees up
+    struct Waiting {
+        Thumbnail thumb;
+        uint64_t lastWanted;
+    };
+
+    void loadNewest();
+    int allocateCell();
+    void upload(int cell, uint64_t hash, const Thumbnail& thumb);
+
+    // GL thread state
+    std::vector<GLuint> m_pages;
+    std::vector<Cell> m_cells;
+    std::unordered_map<uint64_t, int> m_cellOf;       // picture hash -> cell
+    std::unordered_map<TrackId, uint64_t> m_trackHash; // 0: track has no cover
+    std::unordered_set<TrackId> m_pending;
+    std::unordered_map<uint64_t, Waiting> m_waiting; // picture hash -> cover without a cell yet
+    uint64_t m_frame = 0;
+
+    // Shared with background jobs
+    std::mutex m_mutex;
+    std::vector<Request> m_requests; // served newest first: that is what is on screen
+    std::vector<Result> m_results;
+    std::atomic<uint64_t> m_loaderFrame{0};
+    bool m_running = true;
+};
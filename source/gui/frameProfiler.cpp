@@ -0,0 +1,197 @@
+#include "frameProfiler.h"
+
+#include <imgui.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cfloat>
+
+using Clock = std::chrono::steady_clock;
+
+static double ElapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+size_t FrameProfiler::seriesIndex(const char* name, bool gpu) {
+    for (size_t i = 0; i < m_series.size(); ++i) {
+        if (m_series[i].gpu == gpu && (m_series[i].name == name || std::strcmp(m_series[i].name, name) == 0))
+            return i;
+    }
+    Series& series = m_series.emplace_back();
+    series.name = name;
+    series.gpu = gpu;
+    series.samples.resize(HISTORY);
+    return m_series.size() - 1;
+}
+
+void FrameProfiler::push(Series& series, double ms) {
+    series.samples[series.next] = static_cast<float>(ms);
+    series.next = (series.next + 1) % HISTORY;
+    series.count = std::min(series.count + 1, HISTORY);
+}
+
+void FrameProfiler::beginFrame() {
+    if (!m_enabled) return;
+    if (m_series.empty()) seriesIndex("Frame", false);
+
+    // The slot about to be reused was filled QUERY_FRAMES ago, its results are normally ready
+    collect(m_frameIndex % QUERY_FRAMES, false);
+
+    m_inFrame = true;
+    m_open.clear();
+    m_frameStart = Clock::now();
+}
+
+void FrameProfiler::endFrame() {
+    if (!m_enabled || !m_inFrame) return;
+    if (m_gpuOpen) endGpu();
+
+    push(m_series[0], ElapsedMs(m_frameStart));
+    for (size_t i = 1; i < m_series.size(); ++i) {
+        Series& s = m_series[i];
+        if (s.gpu || !s.touched) continue;
+        push(s, s.frameMs);
+        s.frameMs = 0.0;
+        s.touched = false;
+    }
+
+    m_inFrame = false;
+    ++m_frameIndex;
+}
+
+void FrameProfiler::beginCpu(const char* name) {
+    if (!m_enabled || !m_inFrame) return;
+    m_open.push_back({ seriesIndex(name, false), Clock::now() });
+}
+
+void FrameProfiler::endCpu() {
+    if (!m_enabled || m_open.empty()) return;
+    Series& s = m_series[m_open.back().series];
+    s.frameMs += ElapsedMs(m_open.back().start);
+    s.touched = true;
+    m_open.pop_back();
+}
+
+void FrameProfiler::beginGpu(const char* name) {
+    size_t slot = m_frameIndex % QUERY_FRAMES;
+    if (!m_enabled || !m_inFrame || m_gpuOpen || m_queryCount[slot] == MAX_GPU_SCOPES) return;
+
+    GpuQuery& q = m_queries[slot][m_queryCount[slot]++];
+    if (!q.query) glGenQueries(1, &q.query);
+    q.series = seriesIndex(name, true);
+    glBeginQuery(GL_TIME_ELAPSED, q.query);
+    m_gpuOpen = true;
+}
+
+void FrameProfiler::endGpu() {
+    if (!m_gpuOpen) return;
+    glEndQuery(GL_TIME_ELAPSED);
+    m_gpuOpen = false;
+}
+
+void FrameProfiler::collect(size_t slot, bool wait) {
+    for (size_t i = 0; i < m_queryCount[slot]; ++i) {
+        GpuQuery& q = m_queries[slot][i];
+        GLuint available = GL_TRUE;
+        if (!wait) glGetQueryObjectuiv(q.query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) continue; // dropped rather than stalling the frame
+
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(q.query, GL_QUERY_RESULT, &ns);
+        push(m_series[q.series], ns / 1.0e6);
+    }
+    m_queryCount[slot] = 0;
+}
+
+void FrameProfiler::flush() {
+    if (m_gpuOpen) endGpu();
+    // Oldest first, so the history stays in frame order
+    for (size_t i = 0; i < QUERY_FRAMES; ++i)
+        collect((m_frameIndex + i) % QUERY_FRAMES, true);
+}
+
+void FrameProfiler::shutdown() {
+    for (auto& frame : m_queries) {
+        for (auto& q : frame) {
+            if (q.query) glDeleteQueries(1, &q.query);
+            q.query = 0;
+        }
+    }
+    std::fill(std::begin(m_queryCount), std::end(m_queryCount), 0);
+}
+
+const FrameProfiler::Series* FrameProfiler::find(const char* name) const {
+    for (const Series& s : m_series)
+        if (std::strcmp(s.name, name) == 0) return &s;
+    return nullptr;
+}
+
+static double Percentile(const std::vector<float>& samples, size_t count, double p) {
+    if (count == 0) return 0.0;
+    std::vector<float> sorted(samples.begin(), samples.begin() + count);
+    size_t rank = std::min(count - 1, static_cast<size_t>(p / 100.0 * count));
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+}
+
+double FrameProfiler::percentile(const char* name, double p) const {
+    const Series* s = find(name);
+    return s ? Percentile(s->samples, s->count, p) : 0.0;
+}
+
+void FrameProfiler::drawWindow(bool* open) {
+    ImGui::SetNextWindowSize(ImVec2(420, 360), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Profiler", open)) {
+        ImGui::End();
+        return;
+    }
+
+    if (!m_series.empty()) {
+        const Series& frame = m_series[0];
+
+        // 1 ms buckets up to two 60 Hz frames; the last bucket collects the rest
+        constexpr int BUCKETS = 34;
+        float histogram[BUCKETS] = {};
+        for (size_t i = 0; i < frame.count; ++i)
+            histogram[std::min(BUCKETS - 1, static_cast<int>(frame.samples[i]))] += 1.0f;
+
+        ImGui::Text("Frame  p50 %.2f ms   p99 %.2f ms   (%zu frames)",
+                    Percentile(frame.samples, frame.count, 50), Percentile(frame.samples, frame.count, 99), frame.count);
+        ImGui::PlotHistogram("##frametimes", histogram, BUCKETS, 0, "0 - 33+ ms", 0.0f, FLT_MAX, ImVec2(-1, 80));
+    }
+
+    if (ImGui::BeginTable("##scopes", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV)) {
+        ImGui::TableSetupColumn("Scope");
+        ImGui::TableSetupColumn("Last");
+        ImGui::TableSetupColumn("p50");
+        ImGui::TableSetupColumn("p99");
+        ImGui::TableHeadersRow();
+        for (size_t i = 1; i < m_series.size(); ++i) {
+            const Series& s = m_series[i];
+            float last = s.count ? s.samples[(s.next + HISTORY - 1) % HISTORY] : 0.0f;
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn(); ImGui::Text("%s%s", s.name, s.gpu ? " (GPU)" : "");
+            ImGui::TableNextColumn(); ImGui::Text("%.2f", last);
+            ImGui::TableNextColumn(); ImGui::Text("%.2f", Percentile(s.samples, s.count, 50));
+            ImGui::TableNextColumn(); ImGui::Text("%.2f", Percentile(s.samples, s.count, 99));
+        }
+        ImGui::EndTable();
+    }
+    ImGui::End();
+}
+
+std::string FrameProfiler::report() const {
+    std::string out;
+    char line[160];
+    std::snprintf(line, sizeof(line), "%-24s %8s %8s %8s %8s\n", "scope (ms)", "p50", "p99", "max", "samples");
+    out += line;
+    for (const Series& s : m_series) {
+        float max = s.count ? *std::max_element(s.samples.begin(), s.samples.begin() + s.count) : 0.0f;
+        std::string name = std::string(s.name) + (s.gpu ? " (GPU)" : "");
+        std::snprintf(line, sizeof(line), "%-24s %8.3f %8.3f %8.3f %8zu\n", name.c_str(),
+                      Percentile(s.samples, s.count, 50), Percentile(s.samples, s.count, 99), max, s.count);
+        out += line;
+    }
+    return out;
+}
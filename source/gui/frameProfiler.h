@@ -0,0 +1,83 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Scoped CPU timings and GL timer queries per frame, kept as a rolling history
+// for percentiles. Scopes may nest; names must outlive the profiler (literals).
+// All calls are cheap no-ops while disabled.
+class FrameProfiler {
+public:
+    static constexpr size_t HISTORY = 512;
+    static constexpr size_t QUERY_FRAMES = 4;   // GPU results are read this many frames late
+    static constexpr size_t MAX_GPU_SCOPES = 4; // per frame; GL timer queries cannot nest
+
+    struct CpuScope {
+        CpuScope(FrameProfiler& profiler, const char* name) : m_profiler(profiler) { m_profiler.beginCpu(name); }
+        ~CpuScope() { m_profiler.endCpu(); }
+        FrameProfiler& m_profiler;
+    };
+
+    void setEnabled(bool enabled) { m_enabled = enabled; }
+    bool enabled() const { return m_enabled; }
+
+    // Frame time covers building and submitting the frame, not the vsync wait
+    void beginFrame();
+    void endFrame();
+
+    void beginCpu(const char* name);
+    void endCpu();
+    void beginGpu(const char* name);
+    void endGpu();
+
+    // Milliseconds; 0 without samples. "Frame" is the whole frame.
+    double percentile(const char* name, double p) const;
+
+    void drawWindow(bool* open);
+    std::string report() const;
+
+    // Waits for outstanding GPU queries and records them, e.g. before report()
+    void flush();
+    // GL thread, while the context is alive
+    void shutdown();
+
+private:
+    struct Series {
+        const char* name = "";
+        bool gpu = false;
+        double frameMs = 0.0; // accumulated within the current frame
+        bool touched = false;
+        std::vector<float> samples; // ring of HISTORY
+        size_t next = 0;
+        size_t count = 0;
+    };
+
+    struct GpuQuery {
+        GLuint query = 0;
+        size_t series = 0;
+    };
+
+    struct OpenScope {
+        size_t series;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    size_t seriesIndex(const char* name, bool gpu);
+    void push(Series& series, double ms);
+    void collect(size_t slot, bool wait);
+    const Series* find(const char* name) const;
+
+    bool m_enabled = false;
+    bool m_inFrame = false;
+    std::chrono::steady_clock::time_point m_frameStart;
+    std::vector<Series> m_series; // [0] is the frame itself
+    std::vector<OpenScope> m_open;
+
+    GpuQuery m_queries[QUERY_FRAMES][MAX_GPU_SCOPES];
+    size_t m_queryCount[QUERY_FRAMES] = {};
+    size_t m_frameIndex = 0;
+    bool m_gpuOpen = false;
+};
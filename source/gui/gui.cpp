@@ -35,7 +35,8 @@ void SetupImGuiStyle() {
     style.ScrollbarSize = 15.0f;
 }
 
-void SetupImGui(GLFWwindow* window) {
+// Needs no window or GL context, so it can run while those are created
+void SetupImGuiContext() {
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
     ImGuiIO& io = ImGui::GetIO(); (void)io;
@@ -45,7 +46,9 @@ void SetupImGui(GLFWwindow* window) {
     LoadRubikFont(io);
 
     SetupImGuiStyle();
+}
 
+void SetupImGuiBackends(GLFWwindow* window) {
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 330");
 }
\ No newline at end of file
@@ -12,4 +12,5 @@
 #include "loadFonts.h"
 
 void SetupImGuiStyle();
-void SetupImGui(GLFWwindow* window);
\ No newline at end of file
+void SetupImGuiContext();
+void SetupImGuiBackends(GLFWwindow* window);
\ No newline at end of file
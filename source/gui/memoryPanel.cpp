@@ -0,0 +1,119 @@
+#include "memoryPanel.h"
+#include "AllocTracker.h"
+#include "BinaryIO.h"
+#include "files.h"
+
+#include <imgui.h>
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <filesystem>
+
+namespace {
+
+constexpr size_t TAGS = static_cast<size_t>(AllocTag::Count);
+
+// Rates are taken over about a second, so a single burst does not dominate
+struct RateSampler {
+    std::chrono::steady_clock::time_point last = std::chrono::steady_clock::now();
+    uint64_t allocations[TAGS] = {};
+    uint64_t bytes[TAGS] = {};
+    double allocationsPerSecond[TAGS] = {};
+    double bytesPerSecond[TAGS] = {};
+
+    void update() {
+        auto now = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(now - last).count();
+        if (seconds < 1.0) return;
+        for (size_t i = 0; i < TAGS; ++i) {
+            AllocStats stats = GetAllocStats(static_cast<AllocTag>(i));
+            allocationsPerSecond[i] = (stats.allocations - allocations[i]) / seconds;
+            bytesPerSecond[i] = (stats.totalBytes - bytes[i]) / seconds;
+            allocations[i] = stats.allocations;
+            bytes[i] = stats.totalBytes;
+        }
+        last = now;
+    }
+};
+
+RateSampler rates;
+std::string exportedPath;
+
+std::string FormatBytes(double bytes) {
+    char text[32];
+    if (bytes >= 1024.0 * 1024.0) std::snprintf(text, sizeof(text), "%.1f MB", bytes / (1024.0 * 1024.0));
+    else if (bytes >= 1024.0) std::snprintf(text, sizeof(text), "%.1f KB", bytes / 1024.0);
+    else std::snprintf(text, sizeof(text), "%.0f B", bytes);
+    return text;
+}
+
+} // namespace
+
+void DrawMemoryWindow(bool* open) {
+    ImGui::SetNextWindowSize(ImVec2(520, 260), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Memory", open)) {
+        ImGui::End();
+        return;
+    }
+    if (!AllocTrackingEnabled()) {
+        ImGui::TextWrapped("Allocation tracking is off. Start Vesper with VESPER_TRACK_ALLOCS=1 to enable it.");
+        ImGui::End();
+        return;
+    }
+
+    rates.update();
+    if (ImGui::BeginTable("##allocations", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV)) {
+        ImGui::TableSetupColumn("Subsystem");
+        ImGui::TableSetupColumn("Live");
+        ImGui::TableSetupColumn("Peak");
+        ImGui::TableSetupColumn("Allocs/s");
+        ImGui::TableSetupColumn("Bytes/s");
+        ImGui::TableHeadersRow();
+        for (size_t i = 0; i < TAGS; ++i) {
+            AllocStats stats = GetAllocStats(static_cast<AllocTag>(i));
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn(); ImGui::TextUnformatted(AllocTagName(static_cast<AllocTag>(i)));
+            ImGui::TableNextColumn(); ImGui::TextUnformatted(FormatBytes(double(stats.liveBytes)).c_str());
+            ImGui::TableNextColumn(); ImGui::TextUnformatted(FormatBytes(double(stats.peakBytes)).c_str());
+            ImGui::TableNextColumn(); ImGui::Text("%.0f", rates.allocationsPerSecond[i]);
+            ImGui::TableNextColumn(); ImGui::TextUnformatted(FormatBytes(rates.bytesPerSecond[i]).c_str());
+        }
+        ImGui::EndTable();
+    }
+
+    int64_t untracked = UntrackedHeapBytes();
+    if (untracked >= 0) ImGui::Text("C heap outside operator new (FFmpeg, OpenAL, curl): %s", FormatBytes(double(untracked)).c_str());
+
+    if (ImGui::Button("Export JSON")) {
+        std::string path = (std::filesystem::u8path(GetDataDirectory()) / "allocations.json").u8string();
+        exportedPath = ExportAllocationJson(path) ? path : std::string();
+    }
+    if (!exportedPath.empty()) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("%s", exportedPath.c_str());
+    }
+    ImGui::End();
+}
+
+bool ExportAllocationJson(const std::string& path) {
+    nlohmann::json subsystems = nlohmann::json::object();
+    for (size_t i = 0; i < TAGS; ++i) {
+        AllocStats stats = GetAllocStats(static_cast<AllocTag>(i));
+        subsystems[AllocTagName(static_cast<AllocTag>(i))] = {
+            {"liveBytes", stats.liveBytes},
+            {"peakBytes", stats.peakBytes},
+            {"liveBlocks", stats.liveBlocks},
+            {"allocations", stats.allocations},
+            {"totalBytes", stats.totalBytes},
+            {"allocationsPerSecond", rates.allocationsPerSecond[i]},
+            {"bytesPerSecond", rates.bytesPerSecond[i]},
+        };
+    }
+    nlohmann::json report = {
+        {"enabled", AllocTrackingEnabled()},
+        {"subsystems", subsystems},
+        {"untrackedHeapBytes", UntrackedHeapBytes()},
+    };
+
+    return WriteFileAtomically(path, report.dump(2) + "\n", "allocation report");
+}
\ No newline at end of file
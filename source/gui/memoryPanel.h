@@ -0,0 +1,10 @@
+#pragma once
+
+#include <string>
+
+// Live bytes, peak and allocation rate per subsystem, from AllocTracker.
+// F11 in the GUI. Empty unless started with VESPER_TRACK_ALLOCS=1.
+void DrawMemoryWindow(bool* open);
+
+// Same figures as JSON, written to `path`
+bool ExportAllocationJson(const std::string& path);
\ No newline at end of file
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include "Log.h"
+
+// Shared by the native playlist format, the library database and the session file
+
+// Longer front-coded paths are taken for corruption rather than allocated
+constexpr uint32_t MAX_PATH_LENGTH = 1u << 16;
+
+// Buffered sequential reader, so large files never sit in memory whole
+class FileReader {
+public:
+    // `file` is UTF-8, like the paths the writers take
+    explicit FileReader(const std::string& file) {
+#ifdef _WIN32
+        m_fp = _wfopen(std::filesystem::u8path(file).wstring().c_str(), L"rb");
+#else
+        m_fp = std::fopen(file.c_str(), "rb");
+#endif
+    }
+    ~FileReader() { if (m_fp) std::fclose(m_fp); }
+
+    FileReader(const FileReader&) = delete;
+    FileReader& operator=(const FileReader&) = delete;
+
+    bool isOpen() const { return m_fp != nullptr; }
+
+    bool read(void* dst, size_t n) {
+        auto* out = static_cast<char*>(dst);
+        while (n > 0) {
+            if (m_pos == m_len && !fill()) return false;
+            size_t chunk = std::min(n, m_len - m_pos);
+            std::memcpy(out, m_buf + m_pos, chunk);
+            m_pos += chunk; out += chunk; n -= chunk;
+        }
+        return true;
+    }
+
+    bool readVarint(uint32_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            uint8_t byte;
+            if (!read(&byte, 1)) return false;
+            value |= uint32_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+
+    // Varint length followed by the bytes
+    bool readString(std::string& value, uint32_t maxLength = 1u << 20) {
+        uint32_t length;
+        if (!readVarint(length) || length > maxLength) return false;
+        value.resize(length);
+        return read(value.data(), length);
+    }
+
+private:
+    bool fill() {
+        if (!m_fp) return false;
+        m_len = std::fread(m_buf, 1, sizeof(m_buf), m_fp);
+        m_pos = 0;
+        return m_len > 0;
+    }
+
+    std::FILE* m_fp = nullptr;
+    char m_buf[64 * 1024];
+    size_t m_pos = 0;
+    size_t m_len = 0;
+};
+
+inline void WriteVarint(std::string& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+inline void WriteString(std::string& out, const std::string& value) {
+    WriteVarint(out, static_cast<uint32_t>(value.size()));
+    out += value;
+}
+
+// Native byte order; the files never leave the machine
+inline void WriteDouble(std::string& out, double value) {
+    char bytes[sizeof(double)];
+    std::memcpy(bytes, &value, sizeof(double));
+    out.append(bytes, sizeof(double));
+}
+
+// Written aside and renamed, so a crash never leaves a truncated file.
+// `what` names the file in error messages.
+inline bool WriteFileAtomically(const std::string& path, const std::string& data, const char* what) {
+    namespace fs = std::filesystem;
+    fs::path file = fs::u8path(path);
+    fs::path tmp = file;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out || !out.write(data.data(), data.size())) {
+            LOG_ERROR("Could not write " << what << ": " << tmp.u8string());
+            return false;
+        }
+    }
+    std::error_code ec;
+    fs::rename(tmp, file, ec);
+    if (ec) {
+        LOG_ERROR("Could not replace " << what << ": " << ec.message());
+        return false;
+    }
+    return true;
+}
\ No newline at end of file
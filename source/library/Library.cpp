@@ -0,0 +1,98 @@
+#include "Library.h"
+#include <algorithm>
+#include <filesystem>
+
+static std::string MakeDisplayName(const std::string& path, const AudioMetadata& meta) {
+    std::string display = meta.artist.empty() ? meta.title : meta.artist + " - " + meta.title;
+    if (display.empty()) display = std::filesystem::u8path(path).filename().u8string();
+    return display;
+}
+
+TrackId Library::add(const std::string& path, const AudioMetadata& meta) {
+    auto it = m_index.find(path);
+    if (it != m_index.end()) return it->second;
+
+    TrackId id = static_cast<TrackId>(m_paths.size());
+    m_paths.push_back(path);
+    m_metadata.push_back(meta);
+    m_displayNames.push_back(MakeDisplayName(path, meta));
+    m_index.emplace(path, id);
+    m_sort.insert(id, m_paths.back(), m_metadata.back());
+    ++m_revision;
+    return id;
+}
+
+void Library::add(const std::unordered_map<std::string, AudioMetadata>& tracks) {
+    // Add in path order so "Added" follows the folder layout, not hash order
+    std::vector<std::pair<std::string, AudioMetadata>> ordered;
+    ordered.reserve(tracks.size());
+    for (const auto& [path, meta] : tracks) {
+        if (m_index.find(path) == m_index.end()) ordered.emplace_back(path, meta);
+    }
+    std::sort(ordered.begin(), ordered.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    add(std::move(ordered));
+}
+
+void Library::add(std::vector<std::pair<std::string, AudioMetadata>> tracks) {
+    std::vector<TrackId> ids;
+    ids.reserve(tracks.size());
+    m_paths.reserve(m_paths.size() + tracks.size());
+    m_metadata.reserve(m_metadata.size() + tracks.size());
+    m_displayNames.reserve(m_displayNames.size() + tracks.size());
+    m_index.reserve(m_index.size() + tracks.size());
+
+    for (auto& [path, meta] : tracks) {
+        if (m_index.find(path) != m_index.end()) continue;
+        TrackId id = static_cast<TrackId>(m_paths.size());
+        m_displayNames.push_back(MakeDisplayName(path, meta));
+        m_index.emplace(path, id);
+        m_paths.push_back(std::move(path));
+        m_metadata.push_back(std::move(meta));
+        ids.push_back(id);
+    }
+
+    std::vector<const std::string*> paths;
+    std::vector<const AudioMetadata*> metas;
+    paths.reserve(ids.size());
+    metas.reserve(ids.size());
+    for (TrackId id : ids) {
+        paths.push_back(&m_paths[id]);
+        metas.push_back(&m_metadata[id]);
+    }
+    m_sort.insert(ids, paths, metas);
+    ++m_revision;
+}
+
+void Library::updateMetadata(TrackId id, const AudioMetadata& meta) {
+    if (id >= m_metadata.size()) return;
+    m_metadata[id] = meta;
+    m_displayNames[id] = MakeDisplayName(m_paths[id], meta);
+    m_sort.update(id, m_paths[id], meta);
+    ++m_revision;
+}
+
+void Library::updateMetadata(const std::vector<std::pair<TrackId, AudioMetadata>>& updates) {
+    std::vector<TrackId> ids;
+    std::vector<const std::string*> paths;
+    std::vector<const AudioMetadata*> metas;
+    ids.reserve(updates.size());
+    paths.reserve(updates.size());
+    metas.reserve(updates.size());
+    for (const auto& [id, meta] : updates) {
+        if (id >= m_metadata.size()) continue;
+        m_metadata[id] = meta;
+        m_displayNames[id] = MakeDisplayName(m_paths[id], meta);
+        ids.push_back(id);
+    }
+    for (TrackId id : ids) {
+        paths.push_back(&m_paths[id]);
+        metas.push_back(&m_metadata[id]);
+    }
+    m_sort.update(ids, paths, metas);
+    ++m_revision;
+}
+
+TrackId Library::find(const std::string& path) const {
+    auto it = m_index.find(path);
+    return it != m_index.end() ? it->second : INVALID_TRACK;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "files.h"
+#include "SortIndex.h"
+
+constexpr TrackId INVALID_TRACK = ~TrackId(0);
+
+// All known tracks. Ids are indices into the track arrays and never change.
+class Library {
+public:
+    // Adds a track unless its path is already known; returns its id either way
+    TrackId add(const std::string& path, const AudioMetadata& meta);
+    void add(const std::unordered_map<std::string, AudioMetadata>& tracks);
+    // Appends in the given order, e.g. as saved in the library database
+    void add(std::vector<std::pair<std::string, AudioMetadata>> tracks);
+    // Replaces the tags of a known track and refreshes everything derived from them
+    void updateMetadata(TrackId id, const AudioMetadata& meta);
+    // Same for a batch, e.g. tags read in the background after an add
+    void updateMetadata(const std::vector<std::pair<TrackId, AudioMetadata>>& updates);
+
+    TrackId find(const std::string& path) const;
+    size_t size() const { return m_paths.size(); }
+    bool empty() const { return m_paths.empty(); }
+    // Changes with every add or tag update; a cheap key for derived caches
+    uint64_t revision() const { return m_revision; }
+
+    const std::string& path(TrackId id) const { return m_paths[id]; }
+    const AudioMetadata& metadata(TrackId id) const { return m_metadata[id]; }
+    // "Artist - Title", or the file name when the tags are empty
+    const std::string& displayName(TrackId id) const { return m_displayNames[id]; }
+
+    const std::vector<TrackId>& order(SortColumn column) const { return m_sort.order(column); }
+    size_t rankOf(SortColumn column, TrackId id) const { return m_sort.rankOf(column, id); }
+    bool sameAlbum(TrackId a, TrackId b) const { return m_sort.sameAlbum(a, b); }
+
+private:
+    std::vector<std::string> m_paths;
+    std::vector<AudioMetadata> m_metadata;
+    std::vector<std::string> m_displayNames;
+    std::unordered_map<std::string, TrackId> m_index;
+    SortIndex m_sort;
+    uint64_t m_revision = 0;
+};
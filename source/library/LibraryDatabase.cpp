@@ -0,0 +1,93 @@
+#include "LibraryDatabase.h"
+#include "BinaryIO.h"
+#include "Log.h"
+#include <filesystem>
+#include <mutex>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char DATABASE_MAGIC[4] = { 'V', 'L', 'B', '1' };
+
+} // namespace
+
+std::string GetLibraryDatabasePath() {
+    return (fs::u8path(GetDataDirectory()) / "library.vdb").u8string();
+}
+
+bool SaveLibraryDatabase(const Library& library, const std::unordered_set<TrackId>& unsaved) {
+    size_t count = 0;
+    for (TrackId id = 0; id < library.size(); ++id) count += unsaved.count(id) == 0;
+
+    std::string data(DATABASE_MAGIC, sizeof(DATABASE_MAGIC));
+    WriteVarint(data, static_cast<uint32_t>(count));
+
+    const std::string* prev = nullptr;
+    for (TrackId id = 0; id < library.size(); ++id) {
+        if (unsaved.count(id)) continue;
+        const std::string& path = library.path(id);
+        size_t shared = 0;
+        if (prev) {
+            size_t limit = std::min(prev->size(), path.size());
+            while (shared < limit && (*prev)[shared] == path[shared]) ++shared;
+        }
+        WriteVarint(data, static_cast<uint32_t>(shared));
+        WriteVarint(data, static_cast<uint32_t>(path.size() - shared));
+        data.append(path, shared, std::string::npos);
+        prev = &path;
+
+        const AudioMetadata& meta = library.metadata(id);
+        WriteString(data, meta.title);
+        WriteString(data, meta.artist);
+        WriteString(data, meta.album);
+        WriteString(data, meta.date_str);
+        WriteVarint(data, static_cast<uint32_t>(meta.year));
+        WriteVarint(data, static_cast<uint32_t>(meta.track));
+        WriteDouble(data, meta.duration);
+        WriteString(data, meta.albumArtist);
+    }
+
+    // Tag scans save on a worker while adds save on the GUI thread; both use the same temporary file
+    static std::mutex writeMutex;
+    std::lock_guard<std::mutex> lock(writeMutex);
+    return WriteFileAtomically(GetLibraryDatabasePath(), data, "library database");
+}
+
+bool LoadLibraryDatabase(Library& library) {
+    FileReader reader(GetLibraryDatabasePath());
+    char magic[4];
+    uint32_t count;
+    if (!reader.isOpen()) return false;
+    if (!reader.read(magic, 4) || std::memcmp(magic, DATABASE_MAGIC, 4) != 0 || !reader.readVarint(count)) {
+        LOG_WARNING("Ignoring unreadable library database");
+        return false;
+    }
+
+    std::vector<std::pair<std::string, AudioMetadata>> tracks;
+    tracks.reserve(std::min<uint32_t>(count, 1u << 16)); // the count may be corrupt; larger libraries just grow
+    std::string path;
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t shared, suffix, year, track;
+        AudioMetadata meta{};
+        if (!reader.readVarint(shared) || !reader.readVarint(suffix) || shared > path.size()
+            || suffix > MAX_PATH_LENGTH - shared) break;
+        path.resize(shared + suffix);
+        if (!reader.read(path.data() + shared, suffix)
+            || !reader.readString(meta.title) || !reader.readString(meta.artist)
+            || !reader.readString(meta.album) || !reader.readString(meta.date_str)
+            || !reader.readVarint(year) || !reader.readVarint(track)
+            || !reader.read(&meta.duration, sizeof(double))
+            || !reader.readString(meta.albumArtist)) break;
+        meta.year = static_cast<int>(year);
+        meta.track = static_cast<int>(track);
+        tracks.emplace_back(path, std::move(meta));
+    }
+
+    if (tracks.size() != count) {
+        // Keep what was readable; the rest comes back when its folder is added again
+        LOG_WARNING("Library database is truncated, loaded " << tracks.size() << " of " << count << " tracks");
+    }
+    library.add(std::move(tracks));
+    return true;
+}
\ No newline at end of file
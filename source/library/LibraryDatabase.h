@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+#include <unordered_set>
+
+#include "Library.h"
+
+// Binary snapshot of the library in id order, so startup needs no tag reads
+// and "Added" order survives restarts. Paths are front-coded like .vpl.
+std::string GetLibraryDatabasePath();
+
+// Tracks in `unsaved`, e.g. files only queued from the command line, are left out
+bool SaveLibraryDatabase(const Library& library, const std::unordered_set<TrackId>& unsaved = {});
+// Appends the saved tracks; false if there is no database or it is unreadable
+bool LoadLibraryDatabase(Library& library);
\ No newline at end of file
@@ -0,0 +1,194 @@
+#include "Playlist.h"
+#include "BinaryIO.h"
+#include "Log.h"
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char NATIVE_MAGIC[4] = { 'V', 'P', 'L', '1' };
+constexpr const char* NATIVE_EXT = ".vpl";
+constexpr const char* M3U8_EXT = ".m3u8";
+
+std::string SafeFileName(const std::string& name) {
+    std::string safe = name;
+    for (char& c : safe) {
+        if (std::strchr("/\\:*?\"<>|", c)) c = '_';
+    }
+    return safe.empty() ? "Untitled" : safe;
+}
+
+// Collects entries while streaming; unknown paths are resolved in one batch at the end
+class PlaylistBuilder {
+public:
+    explicit PlaylistBuilder(Library& library) : m_library(library) {}
+
+    void add(const std::string& path) {
+        TrackId id = m_library.find(path);
+        if (id == INVALID_TRACK) m_unknown.emplace_back(m_tracks.size(), path);
+        m_tracks.push_back(id);
+    }
+
+    std::vector<TrackId> finish() {
+        if (!m_unknown.empty()) {
+            std::unordered_map<std::string, AudioMetadata> found;
+            for (const auto& [pos, path] : m_unknown) {
+                if (found.count(path)) continue;
+                auto meta = AddAudioFile(path);
+                found.insert(meta.begin(), meta.end());
+            }
+            m_library.add(found);
+            for (const auto& [pos, path] : m_unknown) m_tracks[pos] = m_library.find(path);
+            m_tracks.erase(std::remove(m_tracks.begin(), m_tracks.end(), INVALID_TRACK), m_tracks.end());
+        }
+        return std::move(m_tracks);
+    }
+
+private:
+    Library& m_library;
+    std::vector<TrackId> m_tracks;
+    std::vector<std::pair<size_t, std::string>> m_unknown;
+};
+
+std::optional<std::vector<TrackId>> LoadNative(const std::string& file, Library& library) {
+    FileReader reader(file);
+    char magic[4];
+    uint32_t count;
+    if (!reader.isOpen() || !reader.read(magic, 4) || std::memcmp(magic, NATIVE_MAGIC, 4) != 0
+        || !reader.readVarint(count)) {
+        return std::nullopt;
+    }
+
+    PlaylistBuilder builder(library);
+    std::string path; // reused: each entry only replaces the suffix it does not share
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t shared, suffix;
+        if (!reader.readVarint(shared) || !reader.readVarint(suffix) || shared > path.size()
+            || suffix > MAX_PATH_LENGTH - shared)
+            return std::nullopt;
+        path.resize(shared + suffix);
+        if (!reader.read(path.data() + shared, suffix)) return std::nullopt;
+        builder.add(path);
+    }
+    return builder.finish();
+}
+
+std::optional<std::vector<TrackId>> LoadM3U(const std::string& file, Library& library) {
+    std::ifstream in(fs::u8path(file), std::ios::binary);
+    if (!in) return std::nullopt;
+
+    fs::path baseDir = fs::u8path(file).parent_path();
+    PlaylistBuilder builder(library);
+    std::string line;
+    bool first = true;
+    while (std::getline(in, line)) {
+        if (first && line.compare(0, 3, "\xEF\xBB\xBF") == 0) line.erase(0, 3); // UTF-8 BOM
+        first = false;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        if (line.compare(0, 7, "file://") == 0) line.erase(0, 7);
+
+        fs::path entry = fs::u8path(line);
+        if (entry.is_relative()) entry = (baseDir / entry).lexically_normal();
+        builder.add(entry.u8string());
+    }
+    return builder.finish();
+}
+
+} // namespace
+
+std::string GetPlaylistDirectory() {
+    fs::path dir = fs::u8path(GetDataDirectory()) / "playlists";
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    return dir.u8string();
+}
+
+std::vector<std::string> ListPlaylists() {
+    std::vector<std::string> names;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(fs::u8path(GetPlaylistDirectory()), ec)) {
+        std::string ext = entry.path().extension().u8string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        if (ext == NATIVE_EXT || ext == M3U8_EXT || ext == ".m3u")
+            names.push_back(entry.path().stem().u8string());
+    }
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+    return names;
+}
+
+bool SavePlaylistM3U8(const Playlist& playlist, const Library& library, const std::string& file) {
+    std::ofstream out(fs::u8path(file), std::ios::binary | std::ios::trunc);
+    if (!out) {
+        LOG_ERROR("Could not write playlist: " << file);
+        return false;
+    }
+
+    out << "#EXTM3U\n#PLAYLIST:" << playlist.name << "\n";
+    for (TrackId id : playlist.tracks) {
+        const AudioMetadata& meta = library.metadata(id);
+        out << "#EXTINF:-1," << meta.artist << " - " << meta.title << "\n" << library.path(id) << "\n";
+    }
+    return static_cast<bool>(out);
+}
+
+bool SavePlaylistNative(const Playlist& playlist, const Library& library, const std::string& file) {
+    std::string data(NATIVE_MAGIC, sizeof(NATIVE_MAGIC));
+    WriteVarint(data, static_cast<uint32_t>(playlist.tracks.size()));
+
+    const std::string* prev = nullptr;
+    for (TrackId id : playlist.tracks) {
+        const std::string& path = library.path(id);
+        size_t shared = 0;
+        if (prev) {
+            size_t limit = std::min(prev->size(), path.size());
+            while (shared < limit && (*prev)[shared] == path[shared]) ++shared;
+        }
+        WriteVarint(data, static_cast<uint32_t>(shared));
+        WriteVarint(data, static_cast<uint32_t>(path.size() - shared));
+        data.append(path, shared, std::string::npos);
+        prev = &path;
+    }
+
+    std::ofstream out(fs::u8path(file), std::ios::binary | std::ios::trunc);
+    if (!out || !out.write(data.data(), data.size())) {
+        LOG_ERROR("Could not write playlist: " << file);
+        return false;
+    }
+    return true;
+}
+
+bool SavePlaylist(const Playlist& playlist, const Library& library) {
+    fs::path base = fs::u8path(GetPlaylistDirectory()) / fs::u8path(SafeFileName(playlist.name));
+    bool native = SavePlaylistNative(playlist, library, base.u8string() + NATIVE_EXT);
+    bool m3u = SavePlaylistM3U8(playlist, library, base.u8string() + M3U8_EXT);
+    return native && m3u;
+}
+
+std::optional<Playlist> LoadPlaylistFile(const std::string& file, Library& library) {
+    fs::path p = fs::u8path(file);
+    std::string ext = p.extension().u8string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+
+    auto tracks = ext == NATIVE_EXT ? LoadNative(file, library) : LoadM3U(file, library);
+    if (!tracks) {
+        LOG_WARNING("Could not read playlist: " << file);
+        return std::nullopt;
+    }
+    return Playlist{ p.stem().u8string(), std::move(*tracks) };
+}
+
+std::optional<Playlist> LoadPlaylist(const std::string& name, Library& library) {
+    fs::path base = fs::u8path(GetPlaylistDirectory()) / fs::u8path(SafeFileName(name));
+    for (const char* ext : { NATIVE_EXT, M3U8_EXT, ".m3u" }) {
+        std::string file = base.u8string() + ext;
+        if (fs::exists(fs::u8path(file))) return LoadPlaylistFile(file, library);
+    }
+    return std::nullopt;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <optional>
+
+#include "Library.h"
+
+// Playlists hold track ids only; paths live once in the library
+struct Playlist {
+    std::string name;
+    std::vector<TrackId> tracks;
+};
+
+std::string GetPlaylistDirectory();
+std::vector<std::string> ListPlaylists();
+
+// Portable .m3u8 and compact native .vpl (front-coded paths)
+bool SavePlaylistM3U8(const Playlist& playlist, const Library& library, const std::string& file);
+bool SavePlaylistNative(const Playlist& playlist, const Library& library, const std::string& file);
+bool SavePlaylist(const Playlist& playlist, const Library& library);
+
+// Streams entries and resolves them against the library.
+// Tags are read only for files the library does not know yet.
+std::optional<Playlist> LoadPlaylistFile(const std::string& file, Library& library);
+std::optional<Playlist> LoadPlaylist(const std::string& name, Library& library);
@@ -0,0 +1,136 @@
+#include "Session.h"
+#include "BinaryIO.h"
+#include "Log.h"
+#include <filesystem>
+#include <mutex>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char SESSION_MAGIC[4] = { 'V', 'S', 'S', '2' };
+
+enum SessionFlags : uint32_t {
+    FLAG_SHUFFLE = 1 << 0,
+    FLAG_REPEAT_ONE = 1 << 1,
+    FLAG_ALBUM_GRID = 1 << 2,
+    FLAG_PLAYLIST = 1 << 3,
+    FLAG_SHUFFLE_ORDER = 1 << 4,
+};
+
+void WriteFloat(std::string& out, float value) {
+    char bytes[sizeof(float)];
+    std::memcpy(bytes, &value, sizeof(float));
+    out.append(bytes, sizeof(float));
+}
+
+void WriteUint64(std::string& out, uint64_t value) {
+    char bytes[sizeof(uint64_t)];
+    std::memcpy(bytes, &value, sizeof(uint64_t));
+    out.append(bytes, sizeof(uint64_t));
+}
+
+void WriteTrackIds(std::string& out, const std::vector<TrackId>& ids) {
+    WriteVarint(out, static_cast<uint32_t>(ids.size()));
+    for (TrackId id : ids) WriteVarint(out, id);
+}
+
+// More than any library holds; a larger count means the file is corrupt
+constexpr uint32_t MAX_TRACK_IDS = 1u << 24;
+
+bool ReadTrackIds(FileReader& reader, std::vector<TrackId>& ids) {
+    uint32_t count;
+    if (!reader.readVarint(count) || count > MAX_TRACK_IDS) return false;
+    // Grown as ids are read, so a count past the end of the file costs nothing
+    ids.clear();
+    ids.reserve(std::min<uint32_t>(count, 1u << 16));
+    for (uint32_t i = 0; i < count; ++i) {
+        TrackId id;
+        if (!reader.readVarint(id)) return false;
+        ids.push_back(id);
+    }
+    return true;
+}
+
+} // namespace
+
+std::string GetSessionPath() {
+    return (fs::u8path(GetDataDirectory()) / "session.vss").u8string();
+}
+
+bool SaveSession(const Session& session) {
+    std::string data(SESSION_MAGIC, sizeof(SESSION_MAGIC));
+
+    uint32_t flags = 0;
+    if (session.shuffle) flags |= FLAG_SHUFFLE;
+    if (session.repeatOne) flags |= FLAG_REPEAT_ONE;
+    if (session.albumGrid) flags |= FLAG_ALBUM_GRID;
+    if (session.playlist) flags |= FLAG_PLAYLIST;
+    if (session.shuffleOrder) flags |= FLAG_SHUFFLE_ORDER;
+    WriteVarint(data, flags);
+    WriteVarint(data, static_cast<uint32_t>(session.sortColumn));
+
+    WriteString(data, session.currentFile);
+    WriteDouble(data, session.position);
+    WriteFloat(data, session.volume);
+    WriteFloat(data, session.scrollY);
+
+    if (session.playlist) {
+        WriteString(data, session.playlist->name);
+        WriteTrackIds(data, session.playlist->tracks);
+        WriteVarint(data, static_cast<uint32_t>(session.playlistPos));
+    }
+    // The order is its key and offset; nothing per track
+    if (session.shuffleOrder) {
+        WriteUint64(data, session.shuffleOrder->key());
+        WriteVarint(data, session.shuffleOrder->halfBits());
+        WriteUint64(data, session.shuffleOrder->start());
+        WriteUint64(data, session.shuffleStep);
+    }
+
+    // Periodic saves run on a worker and may meet the one at exit
+    static std::mutex writeMutex;
+    std::lock_guard<std::mutex> lock(writeMutex);
+    return WriteFileAtomically(GetSessionPath(), data, "session");
+}
+
+bool LoadSession(Session& session) {
+    FileReader reader(GetSessionPath());
+    if (!reader.isOpen()) return false;
+
+    Session loaded;
+    char magic[4];
+    uint32_t flags, sortColumn, playlistPos = 0;
+    bool ok = reader.read(magic, 4) && std::memcmp(magic, SESSION_MAGIC, 4) == 0
+        && reader.readVarint(flags) && reader.readVarint(sortColumn)
+        && sortColumn < static_cast<uint32_t>(SortColumn::Count)
+        && reader.readString(loaded.currentFile)
+        && reader.read(&loaded.position, sizeof(double))
+        && reader.read(&loaded.volume, sizeof(float))
+        && reader.read(&loaded.scrollY, sizeof(float));
+    if (ok && (flags & FLAG_PLAYLIST)) {
+        loaded.playlist.emplace();
+        ok = reader.readString(loaded.playlist->name)
+            && ReadTrackIds(reader, loaded.playlist->tracks)
+            && reader.readVarint(playlistPos);
+    }
+    if (ok && (flags & FLAG_SHUFFLE_ORDER)) {
+        uint64_t key, start;
+        uint32_t halfBits;
+        ok = reader.read(&key, sizeof(uint64_t)) && reader.readVarint(halfBits)
+            && reader.read(&start, sizeof(uint64_t)) && reader.read(&loaded.shuffleStep, sizeof(uint64_t));
+        if (ok) loaded.shuffleOrder = ShuffleOrder(key, halfBits, start);
+    }
+    if (!ok) {
+        LOG_WARNING("Ignoring unreadable session file");
+        return false;
+    }
+
+    loaded.shuffle = flags & FLAG_SHUFFLE;
+    loaded.repeatOne = flags & FLAG_REPEAT_ONE;
+    loaded.albumGrid = flags & FLAG_ALBUM_GRID;
+    loaded.sortColumn = static_cast<SortColumn>(sortColumn);
+    loaded.playlistPos = playlistPos;
+    session = std::move(loaded);
+    return true;
+}
\ No newline at end of file
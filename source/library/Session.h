@@ -0,0 +1,35 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "Library.h"
+#include "Playlist.h"
+#include "ShuffleOrder.h"
+
+// Where the user left off: the queue, what played and where, and how the
+// window looked. Track ids are those of the library database, which keeps
+// them stable across restarts.
+struct Session {
+    std::string currentFile;
+    double position = 0.0; // seconds
+    float volume = 0.5f;
+    bool shuffle = false;
+    bool repeatOne = false;
+    SortColumn sortColumn = SortColumn::Added;
+
+    std::optional<Playlist> playlist;
+    size_t playlistPos = 0;
+    std::optional<ShuffleOrder> shuffleOrder;
+    uint64_t shuffleStep = 0;
+
+    float scrollY = 0.0f;
+    bool albumGrid = false;
+};
+
+std::string GetSessionPath();
+
+bool SaveSession(const Session& session);
+// False if there is no session file or it is unreadable
+bool LoadSession(Session& session);
\ No newline at end of file
@@ -0,0 +1,84 @@
+#include "ShuffleOrder.h"
+#include <chrono>
+#include <random>
+
+namespace {
+
+constexpr unsigned ROUNDS = 6;
+constexpr unsigned MAX_HALF_BITS = 16; // 2^32 steps covers every TrackId
+
+// splitmix64 finaliser
+uint64_t Mix(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+} // namespace
+
+ShuffleOrder::ShuffleOrder(uint64_t key, unsigned halfBits, uint64_t start)
+    : m_key(key), m_halfBits(halfBits < MAX_HALF_BITS ? halfBits : MAX_HALF_BITS), m_start(start & (steps() - 1)) {}
+
+ShuffleOrder ShuffleOrder::Create(size_t size, size_t first) {
+    std::random_device device;
+    auto seed = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    std::mt19937_64 rng((uint64_t(device()) << 32) ^ static_cast<uint64_t>(seed));
+
+    // At least twice the size, so a library can double before the order starts over
+    unsigned halfBits = 1;
+    while (halfBits < MAX_HALF_BITS && (uint64_t(1) << (2 * halfBits)) < uint64_t(size) * 2) ++halfBits;
+
+    ShuffleOrder order(rng(), halfBits, 0);
+    order.m_start = first < size ? order.unpermute(first) : rng() & (order.steps() - 1);
+    return order;
+}
+
+uint64_t ShuffleOrder::round(unsigned round, uint64_t half) const {
+    return Mix(m_key ^ (uint64_t(round) << 56) ^ half) & ((uint64_t(1) << m_halfBits) - 1);
+}
+
+uint64_t ShuffleOrder::permute(uint64_t value) const {
+    const uint64_t mask = (uint64_t(1) << m_halfBits) - 1;
+    uint64_t left = value >> m_halfBits, right = value & mask;
+    for (unsigned r = 0; r < ROUNDS; ++r) {
+        uint64_t next = left ^ round(r, right);
+        left = right;
+        right = next;
+    }
+    return (left << m_halfBits) | right;
+}
+
+uint64_t ShuffleOrder::unpermute(uint64_t value) const {
+    const uint64_t mask = (uint64_t(1) << m_halfBits) - 1;
+    uint64_t left = value >> m_halfBits, right = value & mask;
+    for (unsigned r = ROUNDS; r-- > 0;) {
+        uint64_t previous = right ^ round(r, left);
+        right = left;
+        left = previous;
+    }
+    return (left << m_halfBits) | right;
+}
+
+uint64_t ShuffleOrder::at(uint64_t step) const {
+    return permute((m_start + step) & (steps() - 1));
+}
+
+uint64_t ShuffleOrder::stepOf(uint64_t index) const {
+    return (unpermute(index) - m_start) & (steps() - 1);
+}
+
+// The range is under eight times the size, so the walks stay short
+uint64_t ShuffleOrder::next(uint64_t from, size_t size) const {
+    for (uint64_t step = from; step < steps(); ++step) {
+        if (at(step) < size) return step;
+    }
+    return steps();
+}
+
+uint64_t ShuffleOrder::prev(uint64_t before, size_t size) const {
+    for (uint64_t step = before < steps() ? before : steps(); step-- > 0;) {
+        if (at(step) < size) return step;
+    }
+    return steps();
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// A random order of the indices [0, size) that is computed, never stored.
+// A keyed Feistel network permutes a power-of-two range of steps; steps that
+// land on an index >= size are walked over. The range keeps headroom, so
+// indices added later take up steps that were skipped so far and the order
+// of everything already played stays the same.
+class ShuffleOrder {
+public:
+    ShuffleOrder() = default;
+    ShuffleOrder(uint64_t key, unsigned halfBits, uint64_t start);
+
+    // A fresh random order over `size` indices that begins with `first`,
+    // or somewhere random when `first` is not one of them
+    static ShuffleOrder Create(size_t size, size_t first);
+
+    uint64_t key() const { return m_key; }
+    unsigned halfBits() const { return m_halfBits; }
+    uint64_t start() const { return m_start; }
+
+    // Number of steps; also returned by next() and prev() when there is no such step
+    uint64_t steps() const { return uint64_t(1) << (2 * m_halfBits); }
+    bool fits(size_t size) const { return size <= steps(); }
+
+    // Index at a step, possibly >= the current size
+    uint64_t at(uint64_t step) const;
+    // Step of an index; at(stepOf(i)) == i
+    uint64_t stepOf(uint64_t index) const;
+
+    // First step >= from whose index is below size
+    uint64_t next(uint64_t from, size_t size) const;
+    // Last step < before whose index is below size
+    uint64_t prev(uint64_t before, size_t size) const;
+
+private:
+    uint64_t permute(uint64_t value) const;
+    uint64_t unpermute(uint64_t value) const;
+    uint64_t round(unsigned round, uint64_t half) const;
+
+    uint64_t m_key = 0;
+    unsigned m_halfBits = 0;
+    uint64_t m_start = 0;
+};
\ No newline at end of file
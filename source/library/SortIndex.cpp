@@ -0,0 +1,233 @@
+#include "SortIndex.h"
+#include <algorithm>
+#include <filesystem>
+#include <locale>
+#include <cctype>
+#include <string_view>
+
+namespace {
+
+const std::locale& CollationLocale() {
+    static const std::locale loc = [] {
+        try {
+            std::locale user("");
+            if (user.name() != "C" && user.name() != "POSIX") return user;
+        } catch (const std::runtime_error&) {
+            // unknown user locale, fall back below
+        }
+        return std::locale::classic();
+    }();
+    return loc;
+}
+
+void AppendField(std::string& key, const std::string& text) {
+    key += CollationKey(text);
+    key.push_back('\0'); // sorts before any key byte, so shorter fields come first
+}
+
+void AppendNumber(std::string& key, int value) {
+    uint32_t v = static_cast<uint32_t>(value) ^ 0x80000000u; // negative values sort first
+    for (int shift = 24; shift >= 0; shift -= 8)
+        key.push_back(static_cast<char>((v >> shift) & 0xff));
+}
+
+// Album, album artist and folder lead every album key
+constexpr int ALBUM_IDENTITY_FIELDS = 3;
+
+std::string_view AlbumIdentity(const std::string& key) {
+    size_t end = 0;
+    for (int field = 0; field < ALBUM_IDENTITY_FIELDS; ++field) {
+        size_t next = key.find('\0', end);
+        if (next == std::string::npos) break;
+        end = next + 1;
+    }
+    return std::string_view(key).substr(0, end);
+}
+
+} // namespace
+
+const char* SortColumnName(SortColumn column) {
+    switch (column) {
+        case SortColumn::Added:  return "Added";
+        case SortColumn::Title:  return "Title";
+        case SortColumn::Artist: return "Artist";
+        case SortColumn::Album:  return "Album";
+        case SortColumn::Year:   return "Year";
+        default:                 return "";
+    }
+}
+
+std::string CollationKey(const std::string& text) {
+    const std::locale& loc = CollationLocale();
+    static const bool classic = loc == std::locale::classic(); // locale comparison is a name compare
+    if (classic) {
+        // No collation rules available: case-fold ASCII, keep UTF-8 bytes as is
+        std::string key = text;
+        std::transform(key.begin(), key.end(), key.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return key;
+    }
+    const auto& coll = std::use_facet<std::collate<char>>(loc);
+    return coll.transform(text.data(), text.data() + text.size());
+}
+
+bool HasAlbumTag(const AudioMetadata& meta) {
+    return !meta.album.empty() && meta.album != "Unknown Album"; // the tag reader's placeholder
+}
+
+std::string SortIndex::makeKey(SortColumn column, const std::string& path, const AudioMetadata& meta) const {
+    std::string key;
+    switch (column) {
+        case SortColumn::Title:
+            AppendField(key, meta.title);
+            AppendField(key, meta.artist);
+            break;
+        case SortColumn::Artist:
+            AppendField(key, meta.artist);
+            AppendNumber(key, meta.year);
+            AppendField(key, meta.album);
+            AppendNumber(key, meta.track);
+            AppendField(key, meta.title);
+            break;
+        case SortColumn::Album:
+            // Same-named albums by different artists stay apart, and untagged
+            // tracks group by folder instead of forming one nameless album
+            AppendField(key, meta.album);
+            AppendField(key, meta.albumArtist.empty() ? meta.artist : meta.albumArtist);
+            AppendField(key, HasAlbumTag(meta) ? std::string() : std::filesystem::u8path(path).parent_path().u8string());
+            AppendNumber(key, meta.track);
+            AppendField(key, meta.title);
+            break;
+        case SortColumn::Year:
+            AppendNumber(key, meta.year);
+            AppendField(key, meta.artist);
+            AppendField(key, meta.album);
+            AppendNumber(key, meta.track);
+            break;
+        default:
+            break;
+    }
+    return key;
+}
+
+bool SortIndex::less(size_t column, TrackId a, TrackId b) const {
+    // Ties are broken by id, so every order is total and stable
+    int cmp = m_keys[column][a].compare(m_keys[column][b]);
+    return cmp != 0 ? cmp < 0 : a < b;
+}
+
+void SortIndex::insert(TrackId id, const std::string& path, const AudioMetadata& meta) {
+    insert(std::vector<TrackId>{ id }, std::vector<const std::string*>{ &path }, std::vector<const AudioMetadata*>{ &meta });
+}
+
+void SortIndex::insert(const std::vector<TrackId>& ids, const std::vector<const std::string*>& paths,
+                       const std::vector<const AudioMetadata*>& metas) {
+    if (ids.empty()) return;
+
+    for (size_t c = 0; c < NUM_COLUMNS; ++c) {
+        auto column = static_cast<SortColumn>(c);
+        auto& keys = m_keys[c];
+        auto& order = m_orders[c];
+
+        if (column != SortColumn::Added) {
+            TrackId maxId = *std::max_element(ids.begin(), ids.end());
+            if (keys.size() <= maxId) keys.resize(maxId + 1);
+            for (size_t i = 0; i < ids.size(); ++i)
+                keys[ids[i]] = makeKey(column, *paths[i], *metas[i]);
+        }
+
+        auto cmp = [this, c, column](TrackId a, TrackId b) {
+            return column == SortColumn::Added ? a < b : less(c, a, b);
+        };
+
+        if (ids.size() == 1) {
+            order.insert(std::upper_bound(order.begin(), order.end(), ids[0], cmp), ids[0]);
+            continue;
+        }
+
+        // Sort only the new ids, then merge them into the existing order
+        size_t oldSize = order.size();
+        order.insert(order.end(), ids.begin(), ids.end());
+        std::sort(order.begin() + oldSize, order.end(), cmp);
+        std::inplace_merge(order.begin(), order.begin() + oldSize, order.end(), cmp);
+    }
+}
+
+void SortIndex::clear() {
+    for (size_t c = 0; c < NUM_COLUMNS; ++c) {
+        m_keys[c].clear();
+        m_orders[c].clear();
+    }
+}
+
+const std::vector<TrackId>& SortIndex::order(SortColumn column) const {
+    return m_orders[static_cast<size_t>(column)];
+}
+
+void SortIndex::update(TrackId id, const std::string& path, const AudioMetadata& meta) {
+    for (size_t c = 0; c < NUM_COLUMNS; ++c) {
+        auto column = static_cast<SortColumn>(c);
+        if (column == SortColumn::Added || id >= m_keys[c].size()) continue;
+
+        auto& order = m_orders[c];
+        size_t rank = rankOf(column, id);
+        if (rank < order.size()) order.erase(order.begin() + rank);
+
+        m_keys[c][id] = makeKey(column, path, meta);
+        auto it = std::lower_bound(order.begin(), order.end(), id,
+            [this, c](TrackId a, TrackId b) { return less(c, a, b); });
+        order.insert(it, id);
+    }
+}
+
+void SortIndex::update(const std::vector<TrackId>& ids, const std::vector<const std::string*>& paths,
+                       const std::vector<const AudioMetadata*>& metas) {
+    if (ids.size() == 1) {
+        update(ids[0], *paths[0], *metas[0]);
+        return;
+    }
+    if (ids.empty()) return;
+
+    for (size_t c = 0; c < NUM_COLUMNS; ++c) {
+        auto column = static_cast<SortColumn>(c);
+        if (column == SortColumn::Added) continue;
+        auto& keys = m_keys[c];
+        auto& order = m_orders[c];
+
+        std::vector<bool> changed(keys.size(), false);
+        std::vector<TrackId> moved;
+        moved.reserve(ids.size());
+        for (size_t i = 0; i < ids.size(); ++i) {
+            TrackId id = ids[i];
+            if (id >= keys.size()) continue;
+            keys[id] = makeKey(column, *paths[i], *metas[i]); // the last update of a track wins
+            if (!changed[id]) moved.push_back(id);
+            changed[id] = true;
+        }
+
+        // Take the changed ids out, sort them by their new keys and merge them back
+        order.erase(std::remove_if(order.begin(), order.end(), [&](TrackId id) { return changed[id]; }), order.end());
+        auto cmp = [this, c](TrackId a, TrackId b) { return less(c, a, b); };
+        std::sort(moved.begin(), moved.end(), cmp);
+        size_t oldSize = order.size();
+        order.insert(order.end(), moved.begin(), moved.end());
+        std::inplace_merge(order.begin(), order.begin() + oldSize, order.end(), cmp);
+    }
+}
+
+size_t SortIndex::rankOf(SortColumn column, TrackId id) const {
+    size_t c = static_cast<size_t>(column);
+    const auto& order = m_orders[c];
+    auto it = std::lower_bound(order.begin(), order.end(), id, [this, c, column](TrackId a, TrackId b) {
+        return column == SortColumn::Added ? a < b : less(c, a, b);
+    });
+    if (it == order.end() || *it != id) return order.size();
+    return static_cast<size_t>(it - order.begin());
+}
+
+
+bool SortIndex::sameAlbum(TrackId a, TrackId b) const {
+    const auto& keys = m_keys[static_cast<size_t>(SortColumn::Album)];
+    if (a >= keys.size() || b >= keys.size()) return false;
+    return AlbumIdentity(keys[a]) == AlbumIdentity(keys[b]);
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "files.h"
+
+using TrackId = uint32_t;
+
+enum class SortColumn {
+    Added,
+    Title,
+    Artist,
+    Album,
+    Year,
+    Count
+};
+
+const char* SortColumnName(SortColumn column);
+
+// Keeps one sorted permutation of track ids per column.
+// Keys are binary collation keys built once per track, so ordering
+// is a plain memcmp and switching columns costs nothing.
+class SortIndex {
+public:
+    void insert(TrackId id, const std::string& path, const AudioMetadata& meta);
+    void insert(const std::vector<TrackId>& ids, const std::vector<const std::string*>& paths,
+                const std::vector<const AudioMetadata*>& metas);
+    // Re-sorts one track after its tags changed
+    void update(TrackId id, const std::string& path, const AudioMetadata& meta);
+    // Same for many tracks, one merge pass per column
+    void update(const std::vector<TrackId>& ids, const std::vector<const std::string*>& paths,
+                const std::vector<const AudioMetadata*>& metas);
+    void clear();
+
+    const std::vector<TrackId>& order(SortColumn column) const;
+    size_t rankOf(SortColumn column, TrackId id) const;
+    // True when both tracks belong to the same album: same album and album artist,
+    // or the same folder for tracks without an album tag
+    bool sameAlbum(TrackId a, TrackId b) const;
+
+private:
+    static constexpr size_t NUM_COLUMNS = static_cast<size_t>(SortColumn::Count);
+
+    std::string makeKey(SortColumn column, const std::string& path, const AudioMetadata& meta) const;
+    bool less(size_t column, TrackId a, TrackId b) const;
+
+    std::vector<std::string> m_keys[NUM_COLUMNS];
+    std::vector<TrackId> m_orders[NUM_COLUMNS];
+};
+
+// Locale-aware sort key for a UTF-8 string
+std::string CollationKey(const std::string& text);
+
+// False for tracks whose tags are not read yet or have no album
+bool HasAlbumTag(const AudioMetadata& meta);
@@ -0,0 +1,130 @@
+#include "TagScanner.h"
+#include "JobSystem.h"
+#include <algorithm>
+
+void TagScanner::enqueue(std::vector<std::pair<TrackId, std::string>> tracks) {
+    if (tracks.empty()) return;
+
+    size_t jobsToStart = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& [id, path] : tracks) {
+            if (!m_waiting.emplace(id, std::move(path)).second) continue;
+            m_order.push_back(id);
+            ++m_unpublished;
+        }
+        while (m_jobs < m_maxJobs && m_jobs < m_waiting.size()) {
+            ++m_jobs;
+            ++jobsToStart;
+        }
+    }
+    for (size_t i = 0; i < jobsToStart; ++i)
+        GetJobSystem().submit(JobPriority::Background, [this] { work(); });
+}
+
+void TagScanner::prioritize(const std::vector<TrackId>& ids) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_waiting.empty()) return;
+    m_visible = ids;
+}
+
+size_t TagScanner::pending() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_unpublished;
+}
+
+void TagScanner::setMaxJobs(size_t jobs) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_maxJobs = std::max<size_t>(jobs, 1);
+}
+
+bool TagScanner::wait(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_idle.wait_for(lock, timeout, [this] { return m_unpublished == 0; });
+}
+
+void TagScanner::stop() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_unpublished -= m_waiting.size();
+    m_waiting.clear();
+    m_order.clear();
+    m_visible.clear();
+    if (m_unpublished == 0) m_idle.notify_all();
+}
+
+// m_mutex is held
+bool TagScanner::take(TrackId& id, std::string& path) {
+    for (TrackId visible : m_visible) {
+        auto it = m_waiting.find(visible);
+        if (it == m_waiting.end()) continue;
+        id = it->first;
+        path = std::move(it->second);
+        m_waiting.erase(it);
+        return true;
+    }
+    while (!m_order.empty()) {
+        auto it = m_waiting.find(m_order.front());
+        m_order.pop_front();
+        if (it == m_waiting.end()) continue; // read early because it was visible
+        id = it->first;
+        path = std::move(it->second);
+        m_waiting.erase(it);
+        return true;
+    }
+    return false;
+}
+
+void TagScanner::work() {
+    AllocScope alloc(AllocTag::Library);
+    while (true) {
+        TrackId id;
+        std::string path;
+        bool more;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            more = take(id, path);
+            if (!more) {
+                --m_jobs;
+                m_visible.clear();
+            }
+        }
+
+        if (more) {
+            AudioMetadata meta = ReadAudioMetadata(path);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_results.emplace_back(id, std::move(meta));
+        }
+
+        // Every job flushes on its way out, so nothing read is left behind
+        publish(!more);
+        if (!more) return;
+    }
+}
+
+void TagScanner::publish(bool force) {
+    // One batch at a time and in order; a busy publisher is no reason to stop reading
+    std::unique_lock<std::mutex> publishLock(m_publishMutex, std::defer_lock);
+    if (force) publishLock.lock();
+    else if (!publishLock.try_lock()) return;
+
+    Results batch;
+    bool finished;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto now = std::chrono::steady_clock::now();
+        if (m_results.empty() || (!force && now - m_lastPublish < PUBLISH_INTERVAL)) return;
+        m_lastPublish = now;
+        batch.swap(m_results);
+        finished = m_unpublished == batch.size();
+    }
+
+    // Counted as pending until published, so wait() sees the library complete
+    size_t published = batch.size();
+    m_publish(std::move(batch), finished);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_unpublished -= published;
+        if (m_unpublished == 0) m_idle.notify_all();
+    }
+    GetJobSystem().wakeMainThread(); // rows change in place; the GUI may be idle
+}
\ No newline at end of file
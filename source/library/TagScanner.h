@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Library.h"
+
+// Reads tags for tracks that are already listed under their file names.
+// Runs as background jobs; tracks on screen are read first, and results are
+// handed over in batches so the library is republished a few times a
+// second rather than once per file.
+class TagScanner {
+public:
+    using Results = std::vector<std::pair<TrackId, AudioMetadata>>;
+    // Called on a worker, one batch at a time; `finished` on the last one
+    using Publish = std::function<void(Results&& results, bool finished)>;
+
+    static constexpr size_t DEFAULT_JOBS = 3; // leaves the other workers to the GUI
+    static constexpr std::chrono::milliseconds PUBLISH_INTERVAL{ 250 };
+
+    explicit TagScanner(Publish publish) : m_publish(std::move(publish)) {}
+
+    void enqueue(std::vector<std::pair<TrackId, std::string>> tracks);
+    // Tracks visible right now; read before anything else still waiting
+    void prioritize(const std::vector<TrackId>& ids);
+    // Tracks whose tags have not been published yet
+    size_t pending() const;
+    // Jobs reading at once, from the next enqueue on
+    void setMaxJobs(size_t jobs);
+    // Blocks until everything enqueued so far is published; false on timeout
+    bool wait(std::chrono::milliseconds timeout);
+    // Drops the tracks not being read yet; they keep their file names
+    void stop();
+
+private:
+    void work();
+    bool take(TrackId& id, std::string& path);
+    void publish(bool force);
+
+    Publish m_publish;
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<TrackId, std::string> m_waiting;
+    std::deque<TrackId> m_order;        // add order; ids already taken are skipped
+    std::vector<TrackId> m_visible;
+    size_t m_unpublished = 0;            // waiting, being read or in m_results
+    size_t m_jobs = 0;
+    size_t m_maxJobs = DEFAULT_JOBS;
+    std::condition_variable m_idle;
+    Results m_results;
+    std::mutex m_publishMutex;
+    std::chrono::steady_clock::time_point m_lastPublish;
+};
\ No newline at end of file
@@ -1,47 +1,189 @@
 #include <gui.h> 
-#include <iostream>
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+#include <future>
+#include <curl/curl.h>
+#include "Log.h"
+#include "SoakTest.h"
+#include "Headless.h"
 
 void glfw_error_callback(int error, const char* description) {
-    fprintf(stderr, "Glfw Error %d: %s\n", error, description);
+    LOG_ERROR("Glfw Error " << error << ": " << description);
 }
 
-int main(int, char**) {
+// FFmpeg's messages join the application log. Its errors are nearly always
+// about one damaged file, which the caller reports too, so they come in as
+// warnings; its warnings (estimated durations, odd headers) only at debug.
+static void FfmpegLogCallback(void* avcl, int level, const char* fmt, va_list args) {
+    LogLevel mapped = level <= AV_LOG_FATAL ? LogLevel::Error
+                    : level <= AV_LOG_ERROR ? LogLevel::Warning : LogLevel::Debug;
+    if (!LogEnabled(mapped)) return;
+
+    // A line may arrive in pieces
+    thread_local int printPrefix = 1;
+    thread_local std::string pending;
+    char line[1024];
+    av_log_format_line(avcl, level, fmt, args, line, sizeof(line), &printPrefix);
+    pending += line;
+    if (pending.empty() || pending.back() != '\n') return;
+    pending.pop_back();
+    LogWrite(mapped, "FFmpeg: " + pending);
+    pending.clear();
+}
+
+int main(int argc, char** argv) {
+    StartupTimer& startup = GetStartupTimer();
 #ifdef _WIN32
     SetConsoleOutputCP(CP_UTF8);
     SetConsoleCP(CP_UTF8);
 #endif
-    av_log_set_level(AV_LOG_QUIET);
-    
-    glfwSetErrorCallback(glfw_error_callback);
-    if (!glfwInit()) {
-        return 1;
-    }
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-    GLFWwindow* window = glfwCreateWindow(1280, 720, "Vesper", NULL, NULL);
-    if (window == NULL) {
-        return 1;
-    }
-    glfwMakeContextCurrent(window);
-    glfwSwapInterval(1);
-
-    int version = gladLoadGL(glfwGetProcAddress);
-    if (version == 0) {
-        std::cerr << "Failed to initialize OpenGL context\n";
-        glfwDestroyWindow(window);
-        glfwTerminate();
-        return -1;
-    }
-    std::cout << "Loaded OpenGL "  << GLAD_VERSION_MAJOR(version) << "." << GLAD_VERSION_MINOR(version) << "\n";
-    
-    SetupImGui(window);
-    GuiLoop(window);
+    LogLevel logLevel;
+    if (const char* level = std::getenv("VESPER_LOG_LEVEL"); level && ParseLogLevel(level, logLevel))
+        SetLogLevel(logLevel);
+    av_log_set_callback(FfmpegLogCallback);
+    av_log_set_level(AV_LOG_INFO);
+
+    // scan|query|play ...: no window, see Headless.h
+    // --replay[=frames] [--replay-tracks=n]: render offscreen and print frame timings
+    // --realtime: feed the sound device from a real-time priority thread
+    // --log-level=debug|info|warning|error|off, --log-file=path
+    // --soak[=seconds] [--soak-tracks=n] [--soak-seed=n] [--soak-script=path] [--soak-report=path]:
+    //   drive playback without a window and report command latencies
+    int replayFrames = 0;
+    size_t replayTracks = 100000;
+    bool soak = false;
+    SoakOptions soakOptions;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--realtime") g_audio.setRealtime(true);
+        else if (arg == "--replay") replayFrames = 600;
+        else if (arg.rfind("--replay=", 0) == 0) replayFrames = std::max(1, std::atoi(arg.c_str() + 9));
+        else if (arg.rfind("--replay-tracks=", 0) == 0) replayTracks = std::strtoull(arg.c_str() + 16, nullptr, 10);
+        else if (arg == "--soak") soak = true;
+        else if (arg.rfind("--soak=", 0) == 0) { soak = true; soakOptions.seconds = std::max(1.0, std::atof(arg.c_str() + 7)); }
+        else if (arg.rfind("--soak-tracks=", 0) == 0) soakOptions.tracks = std::strtoull(arg.c_str() + 14, nullptr, 10);
+        else if (arg.rfind("--soak-seed=", 0) == 0) soakOptions.seed = std::strtoull(arg.c_str() + 12, nullptr, 10);
+        else if (arg.rfind("--soak-script=", 0) == 0) soakOptions.script = arg.substr(14);
+        else if (arg.rfind("--soak-report=", 0) == 0) soakOptions.reportPath = arg.substr(14);
+        else if (arg.rfind("--log-level=", 0) == 0) {
+            if (ParseLogLevel(arg.substr(12), logLevel)) SetLogLevel(logLevel);
+            else LOG_WARNING("Unknown log level: " << arg.substr(12));
+        }
+        else if (arg.rfind("--log-file=", 0) == 0 && !SetLogFile(arg.substr(11))) {
+            LOG_ERROR("Could not open log file: " << arg.substr(11));
+        }
+    }
+
+    // scan, query and play start without GLFW, OpenGL or the fonts
+    if (argc > 1 && IsHeadlessCommand(argv[1])) {
+        int exitCode = RunHeadless(g_audio, argc, argv, 1);
+        GetJobSystem().shutdown();
+        ShutdownLog();
+        return exitCode;
+    }
+
+    // Needs the sound device only; the user's library and session are left alone
+    if (soak) {
+        int exitCode = 1;
+        try {
+            g_audio.init();
+            exitCode = RunSoakTest(g_audio, soakOptions);
+        } catch (const std::exception& e) {
+            LOG_ERROR(e.what());
+        }
+        GetJobSystem().shutdown();
+        ShutdownLog();
+        return exitCode;
+    }
+
+    // Independent work runs while the window and GL context come up.
+    // Replay needs neither a sound device nor the user's library.
+    std::future<void> audioReady, libraryReady;
+    if (replayFrames == 0) {
+        audioReady = std::async(std::launch::async, [&startup] {
+            StartupTimer::Phase phase(startup, "Audio device");
+            g_audio.init();
+        });
+        libraryReady = std::async(std::launch::async, [&startup] {
+            StartupTimer::Phase phase(startup, "Library database");
+            // A database that cannot be loaded must not keep the app from starting
+            try {
+                g_audio.LoadLibraryDatabase();
+            } catch (const std::exception& e) {
+                LOG_ERROR("Could not load the library database, starting empty: " << e.what());
+            }
+        });
+    }
+    std::future<void> curlReady = std::async(std::launch::async, [&startup] {
+        StartupTimer::Phase phase(startup, "curl init");
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+    });
+    std::future<void> imguiReady = std::async(std::launch::async, [&startup] {
+        StartupTimer::Phase phase(startup, "ImGui + fonts");
+        SetupImGuiContext();
+    });
+
+    GLFWwindow* window = nullptr;
+    {
+        StartupTimer::Phase phase(startup, "Window + GL");
+        glfwSetErrorCallback(glfw_error_callback);
+        if (!glfwInit()) {
+            return 1;
+        }
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        if (replayFrames > 0) glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+        window = glfwCreateWindow(1280, 720, "Vesper", NULL, NULL);
+        if (window == NULL) {
+            return 1;
+        }
+        glfwMakeContextCurrent(window);
+        glfwSwapInterval(1);
+
+        int version = gladLoadGL(glfwGetProcAddress);
+        if (version == 0) {
+            LOG_ERROR("Failed to initialize OpenGL context");
+            glfwDestroyWindow(window);
+            glfwTerminate();
+            return -1;
+        }
+        LOG_INFO("Loaded OpenGL " << GLAD_VERSION_MAJOR(version) << "." << GLAD_VERSION_MINOR(version));
+    }
+
+    imguiReady.get();
+    {
+        StartupTimer::Phase phase(startup, "ImGui backends");
+        SetupImGuiBackends(window);
+    }
+
+    int exitCode = 0;
+    if (audioReady.valid()) {
+        try {
+            audioReady.get();
+        } catch (const std::exception& e) {
+            LOG_ERROR(e.what());
+            exitCode = 1;
+        }
+    }
+    if (libraryReady.valid()) libraryReady.get();
+    curlReady.get();
+
+    if (exitCode == 0) {
+        if (replayFrames > 0) exitCode = GuiReplay(window, replayFrames, replayTracks);
+        else GuiLoop(window);
+    }
+    g_audio.SaveLibraryOnExit();
+    GetJobSystem().shutdown();
+    curl_global_cleanup();
 
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
     glfwDestroyWindow(window);
     glfwTerminate();
+    ShutdownLog();
+    return exitCode;
 }
\ No newline at end of file
@@ -1,8 +1,7 @@
-// TO-DO: cache textures
-
 #include "albumArt.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
+#include "Log.h"
 
 extern "C" {
 #include <libavformat/avformat.h>
@@ -11,13 +10,13 @@ extern "C" {
 }
 
 
-GLuint LoadTextureFromMemory(const unsigned char* data, size_t size) {
+GLuint LoadTextureFromMemory(const unsigned char* data, size_t size, int* outWidth, int* outHeight) {
     int width, height, channels;
 
     // Decode image from memory, force 4 channels (RGBA)
     unsigned char* image_data = stbi_load_from_memory(data, (int)size, &width, &height, &channels, 4);
     if (!image_data) {
-        std::cerr << "Failed to load image from memory: " << stbi_failure_reason() << std::endl;
+        LOG_WARNING("Failed to load image from memory: " << stbi_failure_reason());
         return 0;
     }
 
@@ -39,6 +38,8 @@ GLuint LoadTextureFromMemory(const unsigned char* data, size_t size) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
     stbi_image_free(image_data); // free CPU-side memory
+    if (outWidth) *outWidth = width;
+    if (outHeight) *outHeight = height;
     return textureID;
 }
 
@@ -47,13 +48,13 @@ GLuint LoadAlbumArtTexture(const std::string& filename) {
 
     // Open audio file with FFmpeg
     if (avformat_open_input(&fmt_ctx, filename.c_str(), nullptr, nullptr) < 0) {
-        std::cerr << "Could not open file: " << filename << std::endl;
+        LOG_WARNING("Could not open file: " << filename);
         return 0;
     }
 
     // Read stream info
     if (avformat_find_stream_info(fmt_ctx, nullptr) < 0) {
-        std::cerr << "Could not find stream info: " << filename << std::endl;
+        LOG_WARNING("Could not find stream info: " << filename);
         avformat_close_input(&fmt_ctx);
         return 0;
     }
@@ -75,4 +76,42 @@ GLuint LoadAlbumArtTexture(const std::string& filename) {
     // if no album art found
     avformat_close_input(&fmt_ctx);
     return 0;
-}
\ No newline at end of file
+}
+
+GLuint UploadTextureRGBA(const unsigned char* pixels, int width, int height) {
+    if (!pixels || width <= 0 || height <= 0) return 0;
+
+    // Pixels are already at display size, so no mipmaps
+    GLuint textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return textureID;
+}
+
+bool ReadEmbeddedPicture(const std::string& filename, std::vector<unsigned char>& out) {
+    AVFormatContext* fmt_ctx = nullptr;
+    if (avformat_open_input(&fmt_ctx, filename.c_str(), nullptr, nullptr) < 0) return false;
+
+    // Attached pictures are read with the header, no need to probe the streams
+    bool found = false;
+    for (unsigned int i = 0; i < fmt_ctx->nb_streams && !found; i++) {
+        AVStream* stream = fmt_ctx->streams[i];
+        if (stream->disposition & AV_DISPOSITION_ATTACHED_PIC) {
+            AVPacket* attached_pic = &stream->attached_pic;
+            if (attached_pic->data && attached_pic->size > 0) {
+                out.assign(attached_pic->data, attached_pic->data + attached_pic->size);
+                found = true;
+            }
+        }
+    }
+
+    avformat_close_input(&fmt_ctx);
+    return found;
+}
@@ -3,9 +3,14 @@
 #include <glad/gl.h>    
 #include <iostream>
 #include <string>
+#include <vector>
 #include <GLFW/glfw3.h>
 #include <codecvt>
 #include <locale>
 
-GLuint LoadTextureFromMemory(const unsigned char* data, size_t size);
-GLuint LoadAlbumArtTexture(const std::string& filename);
\ No newline at end of file
+GLuint LoadTextureFromMemory(const unsigned char* data, size_t size, int* outWidth = nullptr, int* outHeight = nullptr);
+GLuint LoadAlbumArtTexture(const std::string& filename);
+GLuint UploadTextureRGBA(const unsigned char* pixels, int width, int height);
+
+// Copies the embedded cover picture (still encoded) out of an audio file
+bool ReadEmbeddedPicture(const std::string& filename, std::vector<unsigned char>& out);
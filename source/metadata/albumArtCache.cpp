@@ -0,0 +1,55 @@
+#include "albumArtCache.h"
+
+AlbumArtCache::AlbumArtCache(size_t budgetBytes) : m_budget(budgetBytes) {}
+
+AlbumArtCache::~AlbumArtCache() {
+    clear();
+}
+
+GLuint AlbumArtCache::acquire(uint64_t key) {
+    auto it = m_entries.find(key);
+    if (it == m_entries.end()) return 0;
+
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    return it->second->texture;
+}
+
+void AlbumArtCache::insert(uint64_t key, GLuint texture, size_t bytes) {
+    if (!texture) return;
+
+    auto it = m_entries.find(key);
+    if (it != m_entries.end()) {
+        // Same picture uploaded twice: keep the cached texture
+        if (it->second->texture != texture) glDeleteTextures(1, &texture);
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        return;
+    }
+
+    m_lru.push_front({ key, texture, bytes });
+    m_entries[key] = m_lru.begin();
+    m_used += bytes;
+    evict();
+}
+
+void AlbumArtCache::setBudget(size_t bytes) {
+    m_budget = bytes;
+    evict();
+}
+
+void AlbumArtCache::clear() {
+    for (auto& entry : m_lru) glDeleteTextures(1, &entry.texture);
+    m_lru.clear();
+    m_entries.clear();
+    m_used = 0;
+}
+
+void AlbumArtCache::evict() {
+    // The front entries are the covers on screen, so they are never evicted
+    while (m_used > m_budget && m_lru.size() > PINNED_ENTRIES) {
+        Entry& victim = m_lru.back();
+        glDeleteTextures(1, &victim.texture);
+        m_used -= victim.bytes;
+        m_entries.erase(victim.key);
+        m_lru.pop_back();
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <cstdint>
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+
+// LRU cache of album art textures keyed by a hash of the embedded picture bytes.
+// Tracks sharing a cover share one texture. Lives on the GL thread.
+class AlbumArtCache {
+public:
+    static constexpr size_t DEFAULT_BUDGET = 64 * 1024 * 1024;
+
+    explicit AlbumArtCache(size_t budgetBytes = DEFAULT_BUDGET);
+    ~AlbumArtCache();
+
+    // Returns 0 on a miss; a hit becomes the most recently used entry
+    GLuint acquire(uint64_t key);
+    void insert(uint64_t key, GLuint texture, size_t bytes);
+
+    void setBudget(size_t bytes);
+    size_t budget() const { return m_budget; }
+    size_t usedBytes() const { return m_used; }
+    void clear();
+
+private:
+    struct Entry {
+        uint64_t key;
+        GLuint texture;
+        size_t bytes;
+    };
+
+    static constexpr size_t PINNED_ENTRIES = 2; // large + small cover of the current track
+
+    void evict();
+
+    std::list<Entry> m_lru; // front = most recently used
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> m_entries;
+    size_t m_budget;
+    size_t m_used = 0;
+};
@@ -1,56 +1,315 @@
-// TO-DO: synced lyrics
-// TO-DO: cache lyrics
-
 #include "getlyrics.h"
+#include "files.h"
+#include "hash.h"
+#include "lrc.h"
 #include <string>
 #include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <list>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
 
 using json = nlohmann::json;
+namespace fs = std::filesystem;
 
-std::optional<std::string> getLyrics(
-    const std::string& artist,
-    const std::string& title,
-    const std::string& userAgent
-)
+namespace {
+
+// lrclib may get the lyrics later, so misses are retried after a week
+constexpr std::time_t NEGATIVE_TTL = 7 * 24 * 60 * 60;
+// Recent tracks stay in memory; older ones are read back from the disk cache
+constexpr size_t MEMORY_CACHE_ENTRIES = 256;
+
+std::mutex endpointMutex;
+std::string endpoint = [] {
+    const char* url = std::getenv("VESPER_LRCLIB_URL");
+    return std::string(url && *url ? url : "https://lrclib.net");
+}();
+
+// Idle sessions, reused so curl keeps connections and TLS sessions alive.
+// Each request takes its own, so a slow prefetch never holds up the playing track.
+std::mutex sessionMutex;
+std::vector<std::unique_ptr<cpr::Session>> idleSessions;
+
+class PooledSession {
+public:
+    PooledSession() {
+        std::lock_guard<std::mutex> lock(sessionMutex);
+        if (idleSessions.empty()) {
+            m_session = std::make_unique<cpr::Session>();
+            return;
+        }
+        m_session = std::move(idleSessions.back());
+        idleSessions.pop_back();
+    }
+    ~PooledSession() {
+        std::lock_guard<std::mutex> lock(sessionMutex);
+        idleSessions.push_back(std::move(m_session));
+    }
+
+    PooledSession(const PooledSession&) = delete;
+    PooledSession& operator=(const PooledSession&) = delete;
+
+    cpr::Session& operator*() { return *m_session; }
+
+private:
+    std::unique_ptr<cpr::Session> m_session;
+};
+
+struct MemoryEntry {
+    uint64_t key;
+    std::optional<LyricsResult> result;
+};
+
+std::mutex memoryMutex;
+std::list<MemoryEntry> memoryLru; // front = most recently used
+std::unordered_map<uint64_t, std::list<MemoryEntry>::iterator> memoryCache;
+std::unordered_set<uint64_t> inFlight; // keys being fetched; guarded by memoryMutex
+std::condition_variable fetchDone;
+
+// memoryMutex is held
+bool FindInMemory(uint64_t key, std::optional<LyricsResult>& out) {
+    auto it = memoryCache.find(key);
+    if (it == memoryCache.end()) return false;
+    memoryLru.splice(memoryLru.begin(), memoryLru, it->second);
+    out = it->second->result;
+    return true;
+}
+
+// memoryMutex is held
+void StoreInMemory(uint64_t key, const std::optional<LyricsResult>& result) {
+    auto it = memoryCache.find(key);
+    if (it != memoryCache.end()) {
+        it->second->result = result;
+        memoryLru.splice(memoryLru.begin(), memoryLru, it->second);
+        return;
+    }
+    memoryLru.push_front({ key, result });
+    memoryCache[key] = memoryLru.begin();
+    while (memoryLru.size() > MEMORY_CACHE_ENTRIES) {
+        memoryCache.erase(memoryLru.back().key);
+        memoryLru.pop_back();
+    }
+}
+
+std::string Lowercase(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return std::tolower(c); });
+    return s;
+}
+
+uint64_t LyricsKey(const std::string& artist, const std::string& title, double duration) {
+    std::string key = Lowercase(artist) + '\x1f' + Lowercase(title) + '\x1f' + std::to_string(std::lround(duration));
+    return HashBytes(key.data(), key.size());
+}
+
+fs::path CacheFile(uint64_t key) {
+    static const fs::path dir = [] {
+        fs::path d = fs::u8path(GetCacheDirectory()) / "lyrics";
+        std::error_code ec;
+        fs::create_directories(d, ec);
+        return d;
+    }();
+    char name[24];
+    std::snprintf(name, sizeof(name), "%016llx.json", static_cast<unsigned long long>(key));
+    return dir / name;
+}
+
+// Returns true on a usable entry; `out` is empty for a cached miss
+bool ReadDiskCache(uint64_t key, std::optional<LyricsResult>& out) {
+    std::ifstream in(CacheFile(key), std::ios::binary);
+    if (!in) return false;
+
+    try {
+        json j = json::parse(in);
+        if (!j.value("found", false)) {
+            if (std::time(nullptr) - j.value("fetched", std::time_t(0)) > NEGATIVE_TTL) return false;
+            out.reset();
+            return true;
+        }
+        out = LyricsResult{ j.value("plainLyrics", ""), j.value("syncedLyrics", "") };
+        return true;
+    }
+    catch (const json::exception&) {
+        return false;
+    }
+}
+
+void WriteDiskCache(uint64_t key, const std::optional<LyricsResult>& result) {
+    json j = {
+        {"found", result.has_value()},
+        {"fetched", std::time(nullptr)}
+    };
+    if (result) {
+        j["plainLyrics"] = result->plainLyrics;
+        j["syncedLyrics"] = result->syncedLyrics;
+    }
+
+    fs::path file = CacheFile(key);
+    fs::path tmp = file;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) return;
+        out << j.dump();
+    }
+    std::error_code ec;
+    fs::rename(tmp, file, ec);
+}
+
+std::string StringField(const json& entry, const char* name) {
+    return entry.contains(name) && entry[name].is_string() ? entry[name].get<std::string>() : std::string();
+}
+
+// false: transient failure (network, rate limit, server error), nothing should be cached
+bool FetchLyrics(const std::string& artist, const std::string& title, double duration,
+                 const std::string& userAgent, std::optional<LyricsResult>& out)
 {
-    cpr::Parameters params{
+    std::string url;
+    {
+        std::lock_guard<std::mutex> lock(endpointMutex);
+        url = endpoint + "/api/search";
+    }
+
+    PooledSession pooled;
+    cpr::Session& session = *pooled;
+    session.SetUrl(cpr::Url{url});
+    session.SetParameters(cpr::Parameters{
         {"artist_name", artist},
         {"track_name",  title}
-    };
-
-    cpr::Header headers{
+    });
+    session.SetHeader(cpr::Header{
         {"User-Agent", userAgent}
-    };
+    });
+    session.SetConnectTimeout(cpr::ConnectTimeout{3000});
+    session.SetTimeout(cpr::Timeout{10000});
 
-    auto r = cpr::Get(
-        cpr::Url{"https://lrclib.net/api/search"},
-        std::move(params),
-        std::move(headers),
-        cpr::Timeout{10000}
-    );
+    auto r = session.Get();
 
-    if (r.status_code != 200 || r.text.empty()) {
-        return std::nullopt;
+    out.reset();
+    if (r.status_code == 404) {
+        return true;
+    }
+    // Only a definite answer is cached; a 429 or 403 says nothing about the track
+    if (r.status_code != 200) {
+        return false;
     }
 
     try
     {
         auto j = json::parse(r.text);
 
-        if (!j.is_array() || j.empty()) {
-            return std::nullopt;
+        if (!j.is_array()) {
+            return false;
+        }
+        if (j.empty()) {
+            return true;
         }
 
-        const auto& best = j[0];
-
-        if (best.contains("plainLyrics") && best["plainLyrics"].is_string()) {
-            return best["plainLyrics"].get<std::string>();
+        // Prefer the release whose length matches the file
+        const json* best = &j[0];
+        if (duration > 0.0) {
+            for (const auto& entry : j) {
+                if (entry.contains("duration") && entry["duration"].is_number()
+                    && std::abs(entry["duration"].get<double>() - duration) <= 2.0) {
+                    best = &entry;
+                    break;
+                }
+            }
         }
 
-        return std::nullopt;
+        LyricsResult result{ StringField(*best, "plainLyrics"), StringField(*best, "syncedLyrics") };
+        if (!result.plainLyrics.empty() || !result.syncedLyrics.empty()) {
+            out = std::move(result);
+        }
+        return true;
     }
     catch (const json::exception&)
     {
-        return std::nullopt;
+        return false;
     }
-}
\ No newline at end of file
+}
+
+bool ReadTextFile(const fs::path& path, std::string& out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    out = ss.str();
+    if (out.compare(0, 3, "\xEF\xBB\xBF") == 0) out.erase(0, 3);
+    return true;
+}
+
+} // namespace
+
+std::optional<LyricsResult> getLocalLyrics(const std::string& audioPath) {
+    fs::path base = fs::u8path(audioPath);
+    std::string text;
+
+    for (const char* ext : {".lrc", ".txt"}) {
+        if (!ReadTextFile(fs::path(base).replace_extension(ext), text)) continue;
+
+        // Plain .txt files sometimes carry timestamps as well
+        std::vector<LyricLine> lines = ParseLrc(text);
+        if (!lines.empty()) return LyricsResult{ LyricLinesToText(lines), text };
+        if (text.find_first_not_of(" \t\r\n") != std::string::npos) return LyricsResult{ text, "" };
+    }
+    return std::nullopt;
+}
+
+void setLyricsEndpoint(const std::string& baseUrl) {
+    std::lock_guard<std::mutex> lock(endpointMutex);
+    endpoint = baseUrl;
+    while (!endpoint.empty() && endpoint.back() == '/') endpoint.pop_back();
+}
+
+std::optional<LyricsResult> getLyrics(
+    const std::string& artist,
+    const std::string& title,
+    double duration,
+    const std::string& userAgent
+)
+{
+    uint64_t key = LyricsKey(artist, title, duration);
+
+    std::optional<LyricsResult> result;
+    {
+        std::lock_guard<std::mutex> lock(memoryMutex);
+        if (FindInMemory(key, result)) return result;
+    }
+    if (ReadDiskCache(key, result)) {
+        std::lock_guard<std::mutex> lock(memoryMutex);
+        StoreInMemory(key, result);
+        return result;
+    }
+
+    // A request for the same track, e.g. its prefetch, may already be on the
+    // way; wait for that one rather than asking twice
+    {
+        std::unique_lock<std::mutex> lock(memoryMutex);
+        fetchDone.wait(lock, [key] { return inFlight.count(key) == 0; });
+        if (FindInMemory(key, result)) return result;
+        inFlight.insert(key);
+    }
+
+    bool fetched = FetchLyrics(artist, title, duration, userAgent, result);
+    if (fetched) WriteDiskCache(key, result);
+    {
+        std::lock_guard<std::mutex> lock(memoryMutex);
+        inFlight.erase(key);
+        if (fetched) StoreInMemory(key, result);
+    }
+    fetchDone.notify_all();
+
+    if (!fetched) return std::nullopt;
+    return result;
+}
@@ -5,8 +5,24 @@
 #include <cpr/cpr.h>
 #include <nlohmann/json.hpp>
 
-std::optional<std::string> getLyrics(
+struct LyricsResult {
+    std::string plainLyrics;
+    std::string syncedLyrics; // LRC text, empty if lrclib has none
+};
+
+// Looks in memory, then in the disk cache, then asks lrclib over one kept-alive
+// session. Misses are cached as well, so repeat listens stay offline.
+std::optional<LyricsResult> getLyrics(
     const std::string& artist,
     const std::string& title,
+    double duration = 0.0,
     const std::string& userAgent = "Vesper[](https://github.com/aprentxdev/Vesper)"
-);
\ No newline at end of file
+);
+
+// Reads a sidecar next to the audio file: "<name>.lrc", then "<name>.txt".
+// Cheap enough to call before every network lookup.
+std::optional<LyricsResult> getLocalLyrics(const std::string& audioPath);
+
+// Base URL of an lrclib-compatible API, e.g. a local stub server in tests.
+// Defaults to VESPER_LRCLIB_URL or https://lrclib.net
+void setLyricsEndpoint(const std::string& baseUrl);
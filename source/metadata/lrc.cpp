@@ -0,0 +1,94 @@
+#include "lrc.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+namespace {
+
+// Reads "mm:ss", "mm:ss.xx", "mm:ss.xxx" or "mm:ss:xx" between the brackets
+bool ParseTimestamp(const std::string& tag, double& seconds) {
+    size_t colon = tag.find(':');
+    if (colon == 0 || colon == std::string::npos) return false;
+    for (size_t i = 0; i < colon; ++i)
+        if (!std::isdigit(static_cast<unsigned char>(tag[i]))) return false;
+
+    size_t pos = colon + 1;
+    size_t secStart = pos;
+    while (pos < tag.size() && std::isdigit(static_cast<unsigned char>(tag[pos]))) ++pos;
+    if (pos == secStart) return false;
+
+    double fraction = 0.0;
+    if (pos < tag.size()) {
+        if (tag[pos] != '.' && tag[pos] != ':') return false;
+        double scale = 0.1;
+        for (++pos; pos < tag.size(); ++pos, scale *= 0.1) {
+            if (!std::isdigit(static_cast<unsigned char>(tag[pos]))) return false;
+            fraction += (tag[pos] - '0') * scale;
+        }
+    }
+
+    seconds = std::atoi(tag.c_str()) * 60.0 + std::atoi(tag.c_str() + secStart) + fraction;
+    return true;
+}
+
+} // namespace
+
+std::vector<LyricLine> ParseLrc(const std::string& text) {
+    std::vector<LyricLine> lines;
+    double offset = 0.0;
+
+    size_t lineStart = 0;
+    while (lineStart < text.size()) {
+        size_t lineEnd = text.find('\n', lineStart);
+        if (lineEnd == std::string::npos) lineEnd = text.size();
+        std::string line = text.substr(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd + 1;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+
+        // Leading tags: any number of timestamps, or a single metadata tag
+        std::vector<double> times;
+        size_t pos = 0;
+        while (pos < line.size() && line[pos] == '[') {
+            size_t close = line.find(']', pos);
+            if (close == std::string::npos) break;
+            std::string tag = line.substr(pos + 1, close - pos - 1);
+            pos = close + 1;
+
+            double t;
+            if (ParseTimestamp(tag, t)) {
+                times.push_back(t);
+            } else if (tag.compare(0, 7, "offset:") == 0) {
+                // Positive offsets make lyrics appear sooner
+                offset = std::atoi(tag.c_str() + 7) / 1000.0;
+            }
+        }
+        if (times.empty()) continue;
+
+        while (pos < line.size() && line[pos] == ' ') ++pos;
+        std::string lyric = line.substr(pos);
+        for (double t : times)
+            lines.push_back({t, lyric});
+    }
+
+    for (auto& l : lines)
+        l.time = std::max(0.0, l.time - offset);
+    std::stable_sort(lines.begin(), lines.end(),
+        [](const LyricLine& a, const LyricLine& b) { return a.time < b.time; });
+    return lines;
+}
+
+int CurrentLyricLine(const std::vector<LyricLine>& lines, double position) {
+    auto it = std::upper_bound(lines.begin(), lines.end(), position,
+        [](double p, const LyricLine& l) { return p < l.time; });
+    return static_cast<int>(it - lines.begin()) - 1;
+}
+
+std::string LyricLinesToText(const std::vector<LyricLine>& lines) {
+    std::string text;
+    for (const auto& l : lines) {
+        text += l.text;
+        text += '\n';
+    }
+    if (!text.empty()) text.pop_back();
+    return text;
+}
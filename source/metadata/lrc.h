@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct LyricLine {
+    double time; // seconds from the start of the track
+    std::string text;
+};
+
+// Parses LRC text into lines sorted by time. Lines with several timestamps are
+// repeated, the [offset:] tag is applied, other tags and untimed lines are dropped.
+std::vector<LyricLine> ParseLrc(const std::string& text);
+
+// Index of the line being sung at `position`, -1 before the first one
+int CurrentLyricLine(const std::vector<LyricLine>& lines, double position);
+
+// Lyric text without timestamps, one line per entry
+std::string LyricLinesToText(const std::vector<LyricLine>& lines);
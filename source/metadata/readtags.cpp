@@ -1,5 +1,4 @@
 #include <glad/gl.h>    
-#include <iostream>
 #include <string>
 #include <GLFW/glfw3.h>
 #include <codecvt>
@@ -7,6 +6,8 @@
 #include <regex>
 #include <algorithm>
 #include <cctype>
+#include <cstdlib>
+#include "Log.h"
 
 extern "C" {
 #include <libavformat/avformat.h>
@@ -15,29 +16,36 @@ extern "C" {
 
 using std::string;
 
-void ReadAudioTags(const char* filename, std::string* title, std::string* artist, std::string* album, int* year, std::string* date_str = nullptr) {
+void ReadAudioTags(const char* filename, std::string* title, std::string* artist, std::string* album, int* year, std::string* date_str = nullptr, int* track = nullptr, double* duration = nullptr, std::string* album_artist = nullptr) {
     *title = "Unknown Title";
     *artist = "Unknown Artist";
     *album = "Unknown Album";
     *year = 0;
     if (date_str) *date_str = "";
+    if (track) *track = 0;
+    if (duration) *duration = 0.0;
+    if (album_artist) *album_artist = "";
 
     AVFormatContext* fmt_ctx = nullptr;
 
     if (avformat_open_input(&fmt_ctx, filename, nullptr, nullptr) < 0) {
-        std::cerr << "Could not open file: " << filename << std::endl;
+        LOG_WARNING("Could not open file: " << filename);
         return;
     }
 
     if (avformat_find_stream_info(fmt_ctx, nullptr) < 0) {
-        std::cerr << "Could not find stream info: " << filename << std::endl;
+        LOG_WARNING("Could not find stream info: " << filename);
         avformat_close_input(&fmt_ctx);
         return;
     }
 
+    if (duration && fmt_ctx->duration != AV_NOPTS_VALUE) {
+        *duration = fmt_ctx->duration / static_cast<double>(AV_TIME_BASE);
+    }
+
     AVDictionary* metadata = fmt_ctx->metadata;
     if (!metadata) {
-        std::cerr << "No metadata found in file: " << filename << std::endl;
+        LOG_DEBUG("No metadata found in file: " << filename);
         avformat_close_input(&fmt_ctx);
         return;
     }
@@ -63,6 +71,12 @@ void ReadAudioTags(const char* filename, std::string* title, std::string* artist
         else if (key_lower == "album") {
             *album = value;
         }
+        else if ((key_lower == "album_artist" || key_lower == "albumartist" || key_lower == "album artist") && album_artist) {
+            *album_artist = value;
+        }
+        else if (key_lower == "track" && track) {
+            *track = std::atoi(value.c_str()); // "3" or "3/12"
+        }
         else if (key_lower == "date" || key_lower == "year") {
             if (date_str) *date_str = value; // if date found
 
@@ -84,12 +98,7 @@ void ReadAudioTags(const char* filename, std::string* title, std::string* artist
 
     avformat_close_input(&fmt_ctx);
 
-    // debug log
-    std::cerr << "Tags read successfully: Title=" << *title << ", Artist=" << *artist
-        << ", Album=" << *album << ", Year=" << *year;
-    if (date_str) {
-        std::cerr << ", Date=" << *date_str;
-    }
-    std::cerr << std::endl;
+    LOG_DEBUG("Tags read successfully: Title=" << *title << ", Artist=" << *artist
+        << ", Album=" << *album << ", Year=" << *year << (date_str ? ", Date=" + *date_str : std::string()));
 }
 
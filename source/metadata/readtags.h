@@ -3,4 +3,4 @@
 #include <iostream>
 using std::string;
 
-void ReadAudioTags(const char* filename, string* title, string* artist, string* album, int* year, std::string* date_str = nullptr);
\ No newline at end of file
+void ReadAudioTags(const char* filename, string* title, string* artist, string* album, int* year, std::string* date_str = nullptr, int* track = nullptr, double* duration = nullptr, std::string* album_artist = nullptr);
\ No newline at end of file
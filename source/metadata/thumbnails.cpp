@@ -0,0 +1,248 @@
+#include "thumbnails.h"
+#include "albumArt.h"
+#include "files.h"
+#include "hash.h"
+#include "stb_image.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define VESPER_HAS_SSE2 1
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char THUMB_MAGIC[4] = { 'V', 'T', 'H', '1' };
+constexpr char REF_MAGIC[4]   = { 'V', 'T', 'R', '1' };
+
+// sum[i] += row[i] for every channel of a row
+void AccumulateRow(uint32_t* sum, const unsigned char* row, int width) {
+    size_t n = size_t(width) * 4;
+    size_t i = 0;
+#ifdef VESPER_HAS_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        __m128i lo = _mm_unpacklo_epi8(px, zero);
+        __m128i hi = _mm_unpackhi_epi8(px, zero);
+        auto* s = reinterpret_cast<__m128i*>(sum + i);
+        _mm_storeu_si128(s + 0, _mm_add_epi32(_mm_loadu_si128(s + 0), _mm_unpacklo_epi16(lo, zero)));
+        _mm_storeu_si128(s + 1, _mm_add_epi32(_mm_loadu_si128(s + 1), _mm_unpackhi_epi16(lo, zero)));
+        _mm_storeu_si128(s + 2, _mm_add_epi32(_mm_loadu_si128(s + 2), _mm_unpacklo_epi16(hi, zero)));
+        _mm_storeu_si128(s + 3, _mm_add_epi32(_mm_loadu_si128(s + 3), _mm_unpackhi_epi16(hi, zero)));
+    }
+#endif
+    for (; i < n; ++i) sum[i] += row[i];
+}
+
+// Averages `pixels` accumulated RGBA sums, each made of `count` source pixels in total
+void AverageSpan(const uint32_t* sum, int pixels, uint32_t count, unsigned char* dst) {
+#ifdef VESPER_HAS_SSE2
+    __m128i acc = _mm_setzero_si128();
+    for (int p = 0; p < pixels; ++p)
+        acc = _mm_add_epi32(acc, _mm_loadu_si128(reinterpret_cast<const __m128i*>(sum + p * 4)));
+    __m128i avg = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(acc), _mm_set1_ps(1.0f / count)));
+    avg = _mm_packs_epi32(avg, avg);
+    avg = _mm_packus_epi16(avg, avg);
+    int packed = _mm_cvtsi128_si32(avg);
+    std::memcpy(dst, &packed, 4);
+#else
+    uint32_t acc[4] = { 0, 0, 0, 0 };
+    for (int p = 0; p < pixels; ++p)
+        for (int c = 0; c < 4; ++c) acc[c] += sum[p * 4 + c];
+    for (int c = 0; c < 4; ++c) dst[c] = static_cast<unsigned char>((acc[c] + count / 2) / count);
+#endif
+}
+
+std::string HexKey(uint64_t key) {
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(key));
+    return buf;
+}
+
+const fs::path& ThumbnailDirectory() {
+    static const fs::path dir = [] {
+        fs::path d = fs::u8path(GetCacheDirectory()) / "thumbnails";
+        std::error_code ec;
+        fs::create_directories(d, ec);
+        return d;
+    }();
+    return dir;
+}
+
+// Writes to a temporary name first so readers never see a half-written file
+bool WriteFileAtomic(const fs::path& file, const std::string& data) {
+    fs::path tmp = file;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out || !out.write(data.data(), data.size())) return false;
+    }
+    std::error_code ec;
+    fs::rename(tmp, file, ec);
+    return !ec;
+}
+
+bool ReadRef(const fs::path& file, uint64_t& hash) {
+    std::ifstream in(file, std::ios::binary);
+    char magic[4];
+    if (!in.read(magic, 4) || std::memcmp(magic, REF_MAGIC, 4) != 0) return false;
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&hash), sizeof(hash)));
+}
+
+void WriteRef(const fs::path& file, uint64_t hash) {
+    std::string data(REF_MAGIC, 4);
+    data.append(reinterpret_cast<const char*>(&hash), sizeof(hash));
+    WriteFileAtomic(file, data);
+}
+
+// Sizes beyond what was written mean a damaged file, read as a cache miss
+bool ReadThumbnail(std::ifstream& in, Thumbnail& thumb, int maxSize) {
+    uint16_t size[2];
+    if (!in.read(reinterpret_cast<char*>(size), sizeof(size)) || !size[0] || !size[1]
+        || size[0] > maxSize || size[1] > maxSize) return false;
+    thumb.width = size[0];
+    thumb.height = size[1];
+    thumb.pixels.resize(size_t(thumb.width) * thumb.height * 4);
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(thumb.pixels.data()), thumb.pixels.size()));
+}
+
+void AppendThumbnail(std::string& data, const Thumbnail& thumb) {
+    uint16_t size[2] = { static_cast<uint16_t>(thumb.width), static_cast<uint16_t>(thumb.height) };
+    data.append(reinterpret_cast<const char*>(size), sizeof(size));
+    data.append(reinterpret_cast<const char*>(thumb.pixels.data()), thumb.pixels.size());
+}
+
+bool ReadThumbnails(const fs::path& file, CoverThumbnails& out) {
+    std::ifstream in(file, std::ios::binary);
+    char magic[4];
+    if (!in.read(magic, 4) || std::memcmp(magic, THUMB_MAGIC, 4) != 0) return false;
+    return ReadThumbnail(in, out.large, COVER_LARGE_SIZE) && ReadThumbnail(in, out.small, COVER_SMALL_SIZE);
+}
+
+void WriteThumbnails(const fs::path& file, const CoverThumbnails& thumbs) {
+    std::string data(THUMB_MAGIC, 4);
+    AppendThumbnail(data, thumbs.large);
+    AppendThumbnail(data, thumbs.small);
+    WriteFileAtomic(file, data);
+}
+
+} // namespace
+
+Thumbnail DownscaleRGBA(const unsigned char* src, int width, int height, int maxSize) {
+    Thumbnail out;
+    if (!src || width <= 0 || height <= 0) return out;
+
+    float scale = std::min(1.0f, float(maxSize) / float(std::max(width, height)));
+    out.width = std::max(1, int(width * scale + 0.5f));
+    out.height = std::max(1, int(height * scale + 0.5f));
+    out.pixels.resize(size_t(out.width) * out.height * 4);
+
+    std::vector<uint32_t> rowSum(size_t(width) * 4);
+    for (int dy = 0; dy < out.height; ++dy) {
+        int y0 = int(int64_t(dy) * height / out.height);
+        int y1 = std::max(y0 + 1, int(int64_t(dy + 1) * height / out.height));
+
+        // Sum the source rows covered by this output row, then average across columns
+        std::fill(rowSum.begin(), rowSum.end(), 0u);
+        for (int y = y0; y < y1; ++y)
+            AccumulateRow(rowSum.data(), src + size_t(y) * width * 4, width);
+
+        unsigned char* dst = out.pixels.data() + size_t(dy) * out.width * 4;
+        for (int dx = 0; dx < out.width; ++dx) {
+            int x0 = int(int64_t(dx) * width / out.width);
+            int x1 = std::max(x0 + 1, int(int64_t(dx + 1) * width / out.width));
+            AverageSpan(rowSum.data() + size_t(x0) * 4, x1 - x0, uint32_t((x1 - x0) * (y1 - y0)), dst + dx * 4);
+        }
+    }
+    return out;
+}
+
+bool LoadCoverThumbnails(const std::string& audioPath, CoverThumbnails& out) {
+    std::error_code ec;
+    fs::path audioFile = fs::u8path(audioPath);
+    auto fileSize = fs::file_size(audioFile, ec);
+    if (ec) return false;
+    auto mtime = fs::last_write_time(audioFile, ec).time_since_epoch().count();
+
+    // Path + size + mtime: an edited file gets a fresh entry
+    uint64_t pathKey = HashBytes(audioPath.data(), audioPath.size(), fileSize ^ HashMix(static_cast<uint64_t>(mtime)));
+    fs::path refFile = ThumbnailDirectory() / (HexKey(pathKey) + ".ref");
+
+    uint64_t hash = 0;
+    if (ReadRef(refFile, hash)) {
+        if (hash == 0) return false; // known to have no cover
+        if (ReadThumbnails(ThumbnailDirectory() / (HexKey(hash) + ".thumb"), out)) {
+            out.hash = hash;
+            return true;
+        }
+    }
+
+    std::vector<unsigned char> encoded;
+    if (!ReadEmbeddedPicture(audioPath, encoded)) {
+        WriteRef(refFile, 0);
+        return false;
+    }
+    out.hash = HashBytes(encoded.data(), encoded.size());
+
+    // Another track of the same album may have produced the thumbnails already
+    fs::path thumbFile = ThumbnailDirectory() / (HexKey(out.hash) + ".thumb");
+    if (!ReadThumbnails(thumbFile, out)) {
+        int width, height, channels;
+        unsigned char* image = stbi_load_from_memory(encoded.data(), (int)encoded.size(), &width, &height, &channels, 4);
+        if (!image) {
+            LOG_WARNING("Failed to load image from memory: " << stbi_failure_reason());
+            WriteRef(refFile, 0); // undecodable is as good as no cover
+            return false;
+        }
+        out.large = DownscaleRGBA(image, width, height, COVER_LARGE_SIZE);
+        stbi_image_free(image);
+        out.small = DownscaleRGBA(out.large.pixels.data(), out.large.width, out.large.height, COVER_SMALL_SIZE);
+        WriteThumbnails(thumbFile, out);
+    }
+
+    WriteRef(refFile, out.hash);
+    return true;
+}
+
+
+void PruneThumbnailCache(uint64_t maxBytes) {
+    struct CacheFile {
+        fs::file_time_type written;
+        uint64_t size;
+        fs::path path;
+    };
+    std::vector<CacheFile> files;
+    uint64_t total = 0;
+    std::error_code ec;
+    for (fs::directory_iterator it(ThumbnailDirectory(), ec), end; !ec && it != end; it.increment(ec)) {
+        std::error_code fileEc;
+        uint64_t size = it->file_size(fileEc);
+        auto written = it->last_write_time(fileEc);
+        if (fileEc) continue;
+        files.push_back({ written, size, it->path() });
+        total += size;
+    }
+    if (total <= maxBytes) return;
+
+    // Down to three quarters, so the next few runs have nothing to do
+    std::sort(files.begin(), files.end(), [](const CacheFile& a, const CacheFile& b) { return a.written < b.written; });
+    uint64_t target = maxBytes / 4 * 3;
+    size_t removed = 0;
+    for (const CacheFile& file : files) {
+        if (total <= target) break;
+        if (fs::remove(file.path, ec)) {
+            total -= file.size;
+            ++removed;
+        }
+    }
+    LOG_INFO("Pruned " << removed << " thumbnail cache files");
+}
\ No newline at end of file
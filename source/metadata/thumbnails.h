@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+struct Thumbnail {
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels; // RGBA8, tightly packed rows
+};
+
+struct CoverThumbnails {
+    uint64_t hash = 0; // hash of the encoded picture, shared by all tracks using it
+    Thumbnail large;   // "Now playing" panel
+    Thumbnail small;   // bottom panel
+};
+
+constexpr int COVER_LARGE_SIZE = 250;
+constexpr int COVER_SMALL_SIZE = 80;
+constexpr uint64_t THUMBNAIL_CACHE_BYTES = 512ull * 1024 * 1024;
+
+// Box-filter downscale so the longer side fits maxSize; never upscales
+Thumbnail DownscaleRGBA(const unsigned char* src, int width, int height, int maxSize);
+
+// Meant for a background thread. Unchanged files are served from the disk cache
+// without opening the container; otherwise the cover is extracted, decoded,
+// downscaled and stored there.
+bool LoadCoverThumbnails(const std::string& audioPath, CoverThumbnails& out);
+
+
+// Deletes the oldest disk cache entries once the cache outgrows `maxBytes`,
+// e.g. those of moved or edited files. Meant for a background thread.
+void PruneThumbnailCache(uint64_t maxBytes = THUMBNAIL_CACHE_BYTES);
\ No newline at end of file